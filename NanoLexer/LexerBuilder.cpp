@@ -5,6 +5,10 @@
 #include <memory.h>
 #include <stdio.h>
 #include <cassert>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 
 #include "LexerBuilder.h"
 
@@ -24,10 +28,258 @@ namespace std
 
 namespace RegularExpression
 {
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task, std::size_t grain)
+    {
+        auto threadCount = std::min<std::size_t>(count / std::max<std::size_t>(grain, 1), std::max(1u, std::thread::hardware_concurrency()));
+        if (threadCount <= 1)
+        {
+            for (std::size_t i = 0; i < count; i++)
+                task(i);
+            return;
+        }
+
+        std::atomic<std::size_t> next{ 0 };
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto* arena = NodeArena::getCurrent();    // the workers allocate in the arena of the caller
+        auto worker = [&]()
+        {
+            ArenaScope arenaScope(arena);
+            for (auto i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    task(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    namespace
+    {
+        // Sets members[c] for each character c of a set.
+        void getMembers(const Set& set, bool (&members)[256])
+        {
+            std::fill(std::begin(members), std::end(members), false);
+            auto addIntervals = [&members](const std::set<Interval>& intervals, bool value)
+            {
+                for (const auto& interval : intervals)
+                {
+                    for (int c = interval.getMin(); c <= interval.getMax(); c++)
+                        members[c] = value;
+                }
+            };
+            if (auto* interval = dynamic_cast<const Interval*>(&set))
+                addIntervals({ *interval }, true);
+            else if (auto* multiInterval = dynamic_cast<const MultiInterval*>(&set))
+                addIntervals(multiInterval->getIntervals(), true);
+            else if (auto* multiAntiInterval = dynamic_cast<const MultiAntiInterval*>(&set))
+            {
+                std::fill(std::begin(members), std::end(members), true);
+                addIntervals(multiAntiInterval->getIntervals(), false);
+            }
+            else if (dynamic_cast<const WholeSet*>(&set))
+                std::fill(std::begin(members), std::end(members), true);
+        }
+
+        // Sorted disjoint ranges [first, second] of the characters of a set.
+        std::vector<std::pair<int, int>> getRanges(const Set& set)
+        {
+            bool members[256];
+            getMembers(set, members);
+            std::vector<std::pair<int, int>> ranges;
+            for (int c = 0; c < 256; c++)
+            {
+                if (!members[c])
+                    continue;
+                if (ranges.size() && ranges.back().second == c - 1)
+                    ranges.back().second = c;
+                else
+                    ranges.emplace_back(c, c);
+            }
+            return ranges;
+        }
+
+        // Ranges of the characters that are not in 'ranges'.
+        std::vector<std::pair<int, int>> reverseRanges(const std::vector<std::pair<int, int>>& ranges)
+        {
+            std::vector<std::pair<int, int>> reversedRanges;
+            int next = 0;
+            for (const auto& range : ranges)
+            {
+                if (range.first > next)
+                    reversedRanges.emplace_back(next, range.first - 1);
+                next = range.second + 1;
+            }
+            if (next < 256)
+                reversedRanges.emplace_back(next, 255);
+            return reversedRanges;
+        }
+
+        std::string rangeToCpp(const std::pair<int, int>& range)
+        {
+            if (range.first == range.second)
+                return "c==" + char2stringExpr(range.first);
+            return "c>=" + char2stringExpr(range.first) + "&&c<=" + char2stringExpr(range.second);
+        }
+
+        // Binary decision tree over the boundaries of the ranges [first, last[: log2(n) comparisons instead of n.
+        std::string rangeTreeToCpp(const std::vector<std::pair<int, int>>& ranges, std::size_t first, std::size_t last)
+        {
+            if (last - first == 1)
+                return "(" + rangeToCpp(ranges[first]) + ")";
+            auto middle = (first + last) / 2;
+            return "(c<" + char2stringExpr(ranges[middle].first) + "?" + rangeTreeToCpp(ranges, first, middle) + ":" + rangeTreeToCpp(ranges, middle, last) + ")";
+        }
+
+        // Condition on 'c' testing the characters of 'set', chosen by the shape of the set: empty when it has few ranges
+        // (they are tested in sequence), a decision tree for a moderate number of ranges, otherwise a bitmap 'name' whose
+        // declaration is added to 'tables'.
+        std::string rangeConditionToCpp(const Set& set, const std::string& name, std::ostringstream& tables, int indent)
+        {
+            const std::size_t maxSequence = 3;
+            const std::size_t maxTree = 8;
+
+            auto ranges = getRanges(set);
+            auto reversedRanges = reverseRanges(ranges);
+            if (std::min(ranges.size(), reversedRanges.size()) <= maxSequence)
+                return "";
+            if (reversedRanges.size() < ranges.size() && reversedRanges.size() <= maxTree)
+                return "!" + rangeTreeToCpp(reversedRanges, 0, reversedRanges.size());
+            if (ranges.size() <= maxTree)
+                return rangeTreeToCpp(ranges, 0, ranges.size());
+
+            unsigned char bitmap[32] = {};
+            for (const auto& range : ranges)
+            {
+                for (int c = range.first; c <= range.second; c++)
+                    bitmap[c >> 3] |= 1 << (c & 7);
+            }
+            auto& scode = tables;
+            INDENT; scode << "static const unsigned char " << name << "[32] = {";
+            for (int i = 0; i < 32; i++)
+                scode << (i ? "," : "") << (int)bitmap[i];
+            scode << "};" << std::endl;
+            return "(unsigned)c<256&&(" + name + "[c>>3]&(1<<(c&7)))";
+        }
+
+        // Value of c as a digit (letters after 9 whatever their case), 99 if it is not one.
+        int digitValue(int c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')
+                return (c | 0x20) - 'a' + 10;
+            return 99;
+        }
+
+        // Statements adding c to the integer value of a base when it is one of its digits consumed by a position of this
+        // base among 'positions' (those of a state). The test is omitted when all the bytes taking the transition are
+        // digits of the base.
+        std::string accumulationToCpp(const PositionSet& positions, const std::vector<int>& byteTransitions, int transition, const std::map<const CharValueNode*, int>& positionBases)
+        {
+            std::map<int, std::vector<char>> baseBytes;     // base => bytes consumed by its positions
+            for (auto* position : positions)
+            {
+                auto iter = positionBases.find(position);
+                if (iter == positionBases.end())
+                    continue;
+                auto& bytes = baseBytes[iter->second];
+                bytes.resize(256);
+                bool members[256];
+                getMembers(*position->getValuesSet(), members);
+                for (int c = 0; c < 256; c++)
+                    bytes[c] |= members[c];
+            }
+            std::string code;
+            for (const auto& pair : baseBytes)
+            {
+                auto base = pair.first;
+                auto anyDigit = false;
+                auto onlyDigits = true;
+                auto onlyDecimalDigits = true;
+                for (int c = 0; c < 256; c++)
+                {
+                    if (byteTransitions[c] != transition)
+                        continue;
+                    anyDigit |= pair.second[c] && digitValue(c) < base;
+                    onlyDigits &= digitValue(c) < base;
+                    onlyDecimalDigits &= c >= '0' && c <= '9';
+                }
+                auto accumulator = "integerAccumulator" + std::to_string(base);
+                auto b = std::to_string(base);
+                if (anyDigit && onlyDigits)
+                    code += accumulator + " = " + accumulator + " * " + b + (onlyDecimalDigits ? " + (c - '0'); " : " + digitValue(c); ");
+                else if (anyDigit)
+                    code += "if (digitValue(c) < " + b + ") " + accumulator + " = " + accumulator + " * " + b + " + digitValue(c); ";
+            }
+            return code;
+        }
+
+        // Statement adding c to the hash of the symbol read when a position of 'hashedPositions' among 'positions' (those
+        // of a state) consumes one of the bytes taking the transition. When the matched lexeme is interned, all its bytes
+        // were consumed by its positions, so that the bytes hashed for other positions do not matter.
+        std::string hashToCpp(const PositionSet& positions, const std::vector<int>& byteTransitions, int transition, const std::set<const CharValueNode*>& hashedPositions)
+        {
+            for (auto* position : positions)
+            {
+                if (!hashedPositions.count(position))
+                    continue;
+                bool members[256];
+                getMembers(*position->getValuesSet(), members);
+                for (int c = 0; c < 256; c++)
+                {
+                    if (members[c] && byteTransitions[c] == transition)
+                        return "symbolHashAccumulator = (symbolHashAccumulator ^ c) * 16777619u; ";
+                }
+            }
+            return "";
+        }
+
+        // Lambda classifying 64 bytes with SSE2: a bitmask of those in 'ranges' (or of those not in the reversed ranges
+        // when there are fewer), one comparison per single byte and three per range. Empty for too many ranges.
+        std::string runClassifierToCpp(const std::vector<std::pair<int, int>>& ranges)
+        {
+            const std::size_t maxRanges = 4;
+
+            auto reversedRanges = reverseRanges(ranges);
+            auto reversed = reversedRanges.size() < ranges.size();
+            const auto& tested = reversed ? reversedRanges : ranges;
+            if (tested.empty() || tested.size() > maxRanges)
+                return "";
+            std::string inSet;
+            for (const auto& range : tested)
+            {
+                std::string term;
+                if (range.first == range.second)
+                    term = "_mm_cmpeq_epi8(x,_mm_set1_epi8((char)" + std::to_string(range.first) + "))";
+                else
+                    term = "bytesInRange(x," + std::to_string(range.first) + "," + std::to_string(range.second - range.first) + ")";
+                inSet = inSet.empty() ? term : "_mm_or_si128(" + inSet + "," + term + ")";
+            }
+            return "[](const char* p){unsigned long long m = 0; for (int i = 0; i < 64; i += 16){__m128i x = _mm_loadu_si128((const __m128i*)(p + i)); "
+                "m |= (unsigned long long)(unsigned)_mm_movemask_epi8(" + inSet + ") << i;} return " + (reversed ? "~m" : "m") + ";}";
+        }
+    }
+
     //////////////////////////////////////////////////////////////////////////
     //  State
 
-    State::State(const PositionSet &a, short id, short acceptLex)
+    State::State(const PositionSet &a, int id, int acceptLex)
         :m_positions(a)
     {
         m_ident = id;
@@ -62,40 +314,64 @@ namespace RegularExpression
         return true;
     }
 
-    void    State::ComputeNextStates(std::map<PositionSet, State>&   mapState, std::vector<State*>&   listState)
+    std::vector<std::pair<PositionSet, PositionSet>> State::ComputeNextPositions(const FollowPositions& follows) const
     {
+        std::vector<std::pair<PositionSet, PositionSet>> nextPositions;
+        std::vector<CharValueNode*> merged;
         auto expressions = m_positions.BreakByPositionSet();
-        for (const auto& pair : expressions)
+        for (auto& pair : expressions)
         {
-            auto& positionSet = pair.first;
-            PositionSet next;
-            for (auto pos : positionSet)
+            // the rows of the positions are sorted arrays: they are merged before building the set
+            merged.clear();
+            for (auto pos : pair.first)
             {
-                auto temp = pos->getNextPos();
-                next.insert(temp.begin(), temp.end());
+                auto row = follows.get(pos);
+                merged.insert(merged.end(), row.first, row.second);
             }
-
-            if (next.size() == 0)
+            if (merged.size() == 0)
                 continue;
+            std::sort(merged.begin(), merged.end(), std::less<CharValueNode*>());
+            merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
 
-            State *newState = nullptr;
-            auto iter = mapState.find(next);
-            if (iter == mapState.end())
+            PositionSet next;
+            for (auto pos : merged)
+                next.insert(next.end(), pos);
+            nextPositions.emplace_back(std::move(next), std::move(pair.second));
+        }
+        return nextPositions;
+    }
+
+    bool    State::ComputeNextStates(const std::vector<std::pair<PositionSet, PositionSet>>& nextPositions, const std::vector<State*>& knownStates, std::unordered_map<PositionSet, State>&   mapState, std::vector<State*>&   listState, std::size_t maxStateCount)
+    {
+        assert(nextPositions.size() == knownStates.size());
+        for (std::size_t i = 0; i < nextPositions.size(); i++)
+        {
+            const auto& pair = nextPositions[i];
+            const auto& next = pair.first;
+            State *newState = knownStates[i];
+            if (!newState)
             {
-                int nextId = (int)mapState.size();
-                auto iter = mapState.emplace(next, State(next,nextId,next.getAcceptLexId()));
-                assert(iter.second);
-                newState = &iter.first->second;
-                listState.push_back(newState);
+                // may have been created by a previous state of the same level
+                auto iter = mapState.find(next);
+                if (iter == mapState.end())
+                {
+                    if (maxStateCount > 0 && mapState.size() >= maxStateCount)
+                        return false;
+                    int nextId = (int)mapState.size();
+                    auto iter = mapState.emplace(next, State(next,nextId,next.getAcceptLexId()));
+                    assert(iter.second);
+                    newState = &iter.first->second;
+                    listState.push_back(newState);
+                }
+                else
+                    newState = &iter->second;
             }
-            else
-                newState = &iter->second;
 
             // if it's not a duplicate transition ... 
             bool alreadyExist = false;
             for (auto& transition : m_transitions)
             {
-                auto exprDisplay = transition.first;
+                const auto& exprDisplay = transition.first;
                 auto state = transition.second;
                 if (state == newState && exprDisplay == pair.second)
                 {
@@ -107,6 +383,7 @@ namespace RegularExpression
                 // ... we save the new transition
                 m_transitions.emplace_back(pair.second, newState);
         }
+        return true;
     }
 
     bool State::removeRedundantTransitions()
@@ -212,30 +489,30 @@ namespace RegularExpression
         return debug;
     }
 
-    void State::printAction(bool isMainContext, std::ostringstream& scode, const State* nextState, const std::set<int>& pops, const std::map<int, LexerContext*>& pushCtx, const std::map<int, std::string>& id2OnMatchCode, bool withOnFailure) const
+    void State::printAction(bool isMainContext, std::ostringstream& scode, const State* nextState, const StateCodeOptions& options) const
     {
-        auto iterCtx = pushCtx.find(nextState->getIdLexAccepted());
-        auto mustPush = iterCtx != pushCtx.end();
-        auto mustReturn = (pops.find(nextState->getIdLexAccepted()) != pops.end());
-        auto iterOnMatch = id2OnMatchCode.find(nextState->getIdLexAccepted());
-        std::string onMatch = (iterOnMatch != id2OnMatchCode.end()) ? iterOnMatch->second : "";
+        auto iterCtx = options.pushCtx.find(nextState->getIdLexAccepted());
+        auto mustPush = iterCtx != options.pushCtx.end();
+        auto mustReturn = (options.pops.find(nextState->getIdLexAccepted()) != options.pops.end());
+        auto iterOnMatch = options.id2OnMatchCode.find(nextState->getIdLexAccepted());
+        std::string onMatch = (iterOnMatch != options.id2OnMatchCode.end()) ? iterOnMatch->second : "";
         if (mustPush)
         {
             if (mustReturn)
             {
-                scode << "return " << iterCtx->second->getName() << "();";
+                scode << "return onContextReturn(" << iterCtx->second->getName() << "());";
             }
             else if (isMainContext)
             {
-                scode << "if (" << iterCtx->second->getName() << "()){ accept((Lexeme)" << nextState->getIdLexAccepted() << "); return true;}else";
-                if (withOnFailure)
+                scode << "if (onContextReturn(" << iterCtx->second->getName() << "())){ accept((Lexeme)" << nextState->getIdLexAccepted() << "); return true;}else";
+                if (options.withOnFailure)
                     scode << "{if (accepted != Lexeme::unknown_) return true; goto fail;}";
                 else
                     scode << " return (accepted != Lexeme::unknown_);";
             }
             else
             {
-                scode << "if (" << iterCtx->second->getName() << "()) goto state0; else " << (withOnFailure ? " goto fail;" : " return false;");
+                scode << "if (onContextReturn(" << iterCtx->second->getName() << "())) goto state0; else " << (options.withOnFailure ? " goto fail;" : " return false;");
             }
         }
         else if (isMainContext)
@@ -280,20 +557,118 @@ namespace RegularExpression
         return false;
     }
 
-    std::string State::toCpp(const std::set<int>& pops, const std::map<int, LexerContext*>& pushCtx, const std::map<int, std::string>& id2OnMatchCode, bool withNoread, bool withOnFailure) const
+    bool State::acceptsOnExit(const std::map<int, LexerContext*>& pushCtx) const
+    {
+        if ((getIdLexAccepted() < 0) || (GetId() == 0))
+            return false;
+        for (const auto& transition : getTransitions())
+        {
+            const auto* nextState = transition.second;
+            if ((nextState->getIdLexAccepted() < 0) || (pushCtx.find(nextState->getIdLexAccepted()) != pushCtx.end()))
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<int> State::getByteTransitions() const
+    {
+        std::vector<int> targets(256, -1);
+        const auto& transitions = getTransitions();
+        // the cases of the switch, then the "if" in sequence and finally the "else"
+        for (std::size_t i = 0; i < transitions.size(); i++)
+        {
+            const auto& expr = transitions[i].first;
+            if (expr.hasOnlySingleChar())
+            {
+                bool members[256];
+                getMembers(*expr.intersectAll(), members);
+                for (int c = 0; c < 256; c++)
+                {
+                    if (members[c] && targets[c] < 0)
+                        targets[c] = (int)i;
+                }
+            }
+        }
+        std::vector<char> inSwitch(256);
+        for (int c = 0; c < 256; c++)
+            inSwitch[c] = (targets[c] >= 0);
+        for (std::size_t i = 0; i < transitions.size(); i++)
+        {
+            const auto& expr = transitions[i].first;
+            if (expr.hasOnlySingleChar())
+                continue;
+            bool members[256];
+            if (expr.size())
+            {
+                std::shared_ptr<Set> condition = EmptySet::get();
+                for (auto* val : expr)
+                    condition = condition->unionWith(val->getValuesSet());
+                getMembers(*condition, members);
+            }
+            else
+            {
+                std::fill(std::begin(members), std::end(members), true);
+            }
+            for (int c = 0; c < 256; c++)
+            {
+                if (members[c] && targets[c] < 0 && !inSwitch[c])
+                    targets[c] = (int)i;
+            }
+        }
+        return targets;
+    }
+
+    std::string State::toCpp(const StateCodeOptions& options, int firstCounter, const std::vector<unsigned long long>* counts) const
     {
         std::ostringstream scode;
         int indent = 2;
         int singleCharCount = 0;
         int otherSetCount = 0;
-        auto isMainContext = (pops.size() == 0);
+        auto isMainContext = (options.pops.size() == 0);
+        std::vector<std::string> accumulations(getTransitions().size());
+        if (options.positionBases || options.hashedPositions)
+        {
+            auto byteTransitions = getByteTransitions();
+            for (std::size_t i = 0; i < accumulations.size(); i++)
+            {
+                if (options.positionBases)
+                    accumulations[i] = accumulationToCpp(getPositions(), byteTransitions, (int)i, *options.positionBases);
+                if (options.hashedPositions)
+                    accumulations[i] += hashToCpp(getPositions(), byteTransitions, (int)i, *options.hashedPositions);
+            }
+        }
 
         if (isReferenced())
         {
             INDENT; scode << "state" << GetId() << ":" << std::endl;
         }
         indent++;
-        if ((getIdLexAccepted() >= 0) && isMainContext)
+        if (options.runScan && (GetId() != 0) && (firstCounter < 0) && IsRecursiveState())
+        {
+            // the bytes of the self transitions are consumed together, before the accept that they would each repeat
+            auto byteTransitions = getByteTransitions();
+            std::vector<std::pair<int, int>> loopRanges;
+            auto accumulates = false;       // the bytes of the run must be accumulated (digits, hash) one by one
+            for (int c = 0; c < 256; c++)
+            {
+                if ((byteTransitions[c] < 0) || (getTransitions()[byteTransitions[c]].second != this))
+                    continue;
+                accumulates |= !accumulations[byteTransitions[c]].empty();
+                if (loopRanges.size() && loopRanges.back().second == c - 1)
+                    loopRanges.back().second = c;
+                else
+                    loopRanges.emplace_back(c, c);
+            }
+            auto classifier = accumulates ? "" : runClassifierToCpp(loopRanges);
+            if (classifier.size())
+            {
+                scode << "#if NANOLEXER_SIMD" << std::endl;
+                INDENT; scode << "skipRun(" << classifier << ");" << std::endl;
+                scode << "#endif" << std::endl;
+            }
+        }
+        auto onExit = isMainContext && acceptsOnExit(options.pushCtx);
+        if ((getIdLexAccepted() >= 0) && isMainContext && !onExit)
         {
             INDENT; scode << "accept((Lexeme)" << getIdLexAccepted() << ");" << std::endl;
         }
@@ -309,23 +684,134 @@ namespace RegularExpression
         {
             INDENT; if (GetId() == 0) scode << "int ";
         }
-        if (isMainContext)
+        if (onExit)
+        {
+            scode << "c = get(); if (c==Traits::eof()){ accept((Lexeme)" << getIdLexAccepted() << "); return true;}" << std::endl;
+        }
+        else if (isMainContext)
         {
             scode << "c = get(); if (c==Traits::eof()) goto eof;" << std::endl;
         }
         else
         {
-            scode << "c = get(); if (c==Traits::eof())" << (withOnFailure?" goto fail;":" return false;") << std::endl;
+            scode << "c = get(); if (c==Traits::eof())" << (options.withOnFailure?" goto fail;":" return false;") << std::endl;
         }
-        if ((GetId() == 0) && !isMainContext && withNoread)
+        if ((GetId() == 0) && !isMainContext && options.withNoread)
         {
             indent--;
             INDENT; scode << "state0_noread:" << std::endl; indent++;
         }
-        for (const auto& transition : getTransitions())
+        const auto& transitions = getTransitions();
+        std::vector<std::size_t> order(transitions.size());
+        std::vector<std::string> conditions(transitions.size());     // empty to test the positions in sequence
+        std::vector<char> unreachable(transitions.size());
+        std::ostringstream tables;
+        for (std::size_t i = 0; i < transitions.size(); i++)
+            order[i] = i;
+        auto countOf = [counts](std::size_t i) { return (i < counts->size()) ? (*counts)[i] : 0ULL; };
+        std::shared_ptr<Set> previous = EmptySet::get();
+        for (std::size_t i = 0; i < transitions.size(); i++)
         {
-            const auto& expr = transition.first;
-            const auto* nextState = transition.second;
+            const auto& expr = transitions[i].first;
+            if (expr.hasOnlySingleChar() || !expr.size())
+                continue;
+            std::shared_ptr<Set> condition = EmptySet::get();
+            for (auto* val : expr)
+                condition = condition->unionWith(val->getValuesSet());
+            auto tested = condition;
+            if (counts)
+            {
+                // the "if" are tested in sequence: each one stands for its condition minus the conditions of the previous
+                // ones. These exact sets are tested instead when they differ, so that the order does not matter anymore.
+                tested = condition->substract(previous);
+                previous = previous->unionWith(condition);
+                if (tested == EmptySet::get())
+                {
+                    unreachable[i] = true;
+                    continue;
+                }
+            }
+            conditions[i] = rangeConditionToCpp(*tested, "charSet" + std::to_string(GetId()) + "_" + std::to_string(i), tables, indent);
+            if (conditions[i].empty() && !(*tested == *condition))
+                conditions[i] = tested->toCpp("c", false);
+        }
+        std::vector<std::string> actions(transitions.size());
+        for (std::size_t i = 0; i < transitions.size(); i++)
+        {
+            const auto* nextState = transitions[i].second;
+            std::ostringstream action;
+            if (firstCounter >= 0)
+                action << "++profileCounters[" << firstCounter + i << "]; ";
+            if (accumulations[i].size())
+                action << "{" << accumulations[i];
+            if (nextState->getTransitions().size())
+                action << "goto state" << nextState->GetId() << ";";
+            else if (nextState->getIdLexAccepted() >= 0)
+                printAction(isMainContext, action, nextState, options);
+            else
+                assert(false);
+            if (accumulations[i].size())
+                action << "}";
+            actions[i] = action.str();
+        }
+        if (options.byteClasses)
+        {
+            // one indirect jump on the class of the byte, to the next state or to the label of the action of the transition
+            auto classCount = *std::max_element(options.byteClasses->begin(), options.byteClasses->end()) + 1;
+            auto label = "state" + std::to_string(GetId()) + "_";
+            std::vector<std::string> targets(classCount, label + "none");
+            auto byteTransitions = getByteTransitions();
+            for (int c = 0; c < 256; c++)
+            {
+                auto i = byteTransitions[c];
+                if (i < 0)
+                    continue;
+                const auto* nextState = transitions[i].second;
+                if (nextState->getTransitions().size() && firstCounter < 0 && accumulations[i].empty())
+                    targets[(*options.byteClasses)[c]] = "state" + std::to_string(nextState->GetId());
+                else
+                    targets[(*options.byteClasses)[c]] = label + std::to_string(i);
+            }
+            scode << "#if NANOLEXER_COMPUTED_GOTO" << std::endl;
+            INDENT; scode << "static void* const dispatch" << GetId() << "[" << classCount << "] = {";
+            for (std::size_t k = 0; k < targets.size(); k++)
+                scode << (k ? "," : "") << "&&" << targets[k];
+            scode << "};" << std::endl;
+            INDENT; scode << "if (sizeof(typename Traits::char_type) > 1 && c > 255) goto " << label << "none;" << std::endl;
+            INDENT; scode << "goto *dispatch" << GetId() << "[charClasses[c]];" << std::endl;
+            for (std::size_t i = 0; i < transitions.size(); i++)
+            {
+                if (std::find(targets.begin(), targets.end(), label + std::to_string(i)) == targets.end())
+                    continue;
+                indent--;
+                INDENT; scode << label << i << ":" << std::endl;
+                indent++;
+                INDENT; scode << actions[i] << std::endl;
+            }
+            indent--;
+            INDENT; scode << label << "none:" << std::endl;
+            indent++;
+            scode << "#else" << std::endl;
+        }
+        scode << tables.str();
+        if (counts)
+        {
+            // the cases of the switch first, then the "if" and finally the "else"
+            auto rank = [&transitions](std::size_t i) { return transitions[i].first.hasOnlySingleChar() ? 0 : (transitions[i].first.size() ? 1 : 2); };
+            std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+                {
+                    if (rank(a) != rank(b))
+                        return rank(a) < rank(b);
+                    return countOf(a) > countOf(b);
+                });
+        }
+        for (auto i : order)
+        {
+            if (unreachable[i])
+                continue;
+            const auto& expr = transitions[i].first;
+            const auto& action = actions[i];
+            auto unlikely = (counts && countOf(i) == 0) ? "NANOLEXER_UNLIKELY " : "";
             if (expr.hasOnlySingleChar())
             {
                 if (singleCharCount == 0)
@@ -348,16 +834,7 @@ namespace RegularExpression
                     interval = inter.get();
                 }
                 INDENT;
-                scode << "case " << char2stringExpr(interval->getMin()) << ": ";
-                if (nextState->getTransitions().size())
-                    scode << "goto state" << nextState->GetId() << ";" << std::endl;
-                else if (nextState->getIdLexAccepted() >= 0)
-                {
-                    printAction(isMainContext, scode, nextState, pops, pushCtx, id2OnMatchCode, withOnFailure);
-                    scode << std::endl;
-                }
-                else
-                    assert(false);
+                scode << "case " << char2stringExpr(interval->getMin()) << ": " << unlikely << action << std::endl;
                 singleCharCount++;
             }
             else
@@ -371,37 +848,35 @@ namespace RegularExpression
                 {
                     // then it's an "else"
                     scode << "if (";
-                    int cpt = 0;
-                    bool withParenthesis = expr.size() > 1;
-                    for (auto *val : expr)
+                    if (conditions[i].size())
                     {
-                        if (cpt)
-                            scode << "||";
-                        if (withParenthesis)
-                            scode << "(";
-                        auto condition = val->toCpp("c", false);
-                        if (condition.length() == 0)
-                            assert(false);
-                        scode << condition;
-                        if (withParenthesis)
-                            scode << ")";
-                        cpt++;
+                        scode << conditions[i];
                     }
-                    scode << ") ";
-                }
-                if (nextState->getTransitions().size())
-                {
-                    scode << "goto state" << nextState->GetId() << ";" << std::endl;
-                }
-                else if (nextState->getIdLexAccepted() >= 0)
-                {
-                    printAction(isMainContext, scode, nextState, pops, pushCtx, id2OnMatchCode, withOnFailure);
-                    scode << std::endl;
+                    else
+                    {
+                        int cpt = 0;
+                        bool withParenthesis = expr.size() > 1;
+                        for (auto *val : expr)
+                        {
+                            if (cpt)
+                                scode << "||";
+                            if (withParenthesis)
+                                scode << "(";
+                            auto condition = val->toCpp("c", false);
+                            if (condition.length() == 0)
+                                assert(false);
+                            scode << condition;
+                            if (withParenthesis)
+                                scode << ")";
+                            cpt++;
+                        }
+                    }
+                    scode << ") " << unlikely;
                 }
+                if (firstCounter >= 0)
+                    scode << "{" << action << "}" << std::endl;
                 else
-                {
-                    assert(false);
-                }
+                    scode << action << std::endl;
                 otherSetCount++;
             }
         }
@@ -409,12 +884,18 @@ namespace RegularExpression
         {
             INDENT; scode << "}" << std::endl;    // closes the switch
         }
+        if (options.byteClasses)
+            scode << "#endif" << std::endl;
         if (getIdLexAccepted() >= 0)
         {
-            auto mustReturn = (pops.find(getIdLexAccepted()) != pops.end())||isMainContext;
-            auto iterOnMatch = id2OnMatchCode.find(getIdLexAccepted());
-            std::string onMatch = (!isMainContext && (iterOnMatch != id2OnMatchCode.end())) ? iterOnMatch->second : "";
-            if (mustReturn)
+            auto mustReturn = (options.pops.find(getIdLexAccepted()) != options.pops.end())||isMainContext;
+            auto iterOnMatch = options.id2OnMatchCode.find(getIdLexAccepted());
+            std::string onMatch = (!isMainContext && (iterOnMatch != options.id2OnMatchCode.end())) ? iterOnMatch->second : "";
+            if (onExit)
+            {
+                INDENT; scode << "acceptBeforeLast((Lexeme)" << getIdLexAccepted() << "); return true;" << std::endl;
+            }
+            else if (mustReturn)
             {
                 if (onMatch.empty())
                 {
@@ -439,11 +920,11 @@ namespace RegularExpression
         }
         else if (!isMainContext)
         {
-            INDENT; scode << (withOnFailure ? "goto fail;" : "return false;") << std::endl;
+            INDENT; scode << (options.withOnFailure ? "goto fail;" : "return false;") << std::endl;
         }
         else
         {
-            if (withOnFailure)
+            if (options.withOnFailure)
             {
                 INDENT; scode << "if (accepted!=Lexeme::unknown_) return true; goto fail;" << std::endl;
             }
@@ -457,6 +938,344 @@ namespace RegularExpression
 
     //////////////////////////////////////////////////////////////////////////
 
+    PositionAutomaton::PositionAutomaton(const PositionSet& firstPositions, const FollowPositions& follows)
+    {
+        // the positions are numbered in the order they are reached, the end positions only mark the accepting ones
+        std::unordered_map<const CharValueNode*, int> numbers;
+        std::vector<CharValueNode*> positions;
+        auto number = [&numbers, &positions](CharValueNode* position)
+        {
+            if (dynamic_cast<EndNode*>(position) || numbers.count(position))
+                return;
+            numbers.emplace(position, (int)positions.size());
+            positions.push_back(position);
+        };
+        for (auto* position : firstPositions)
+            number(position);
+        for (std::size_t i = 0; i < positions.size() && positions.size() <= (std::size_t)maxPositionCount; i++)
+        {
+            auto range = follows.get(positions[i]);
+            for (auto* next = range.first; next != range.second; next++)
+                number(*next);
+        }
+        m_positionCount = (int)positions.size();
+        if (m_positionCount > maxPositionCount)
+            return;
+
+        m_wordCount = std::max(1, (m_positionCount + 63) / 64);
+        auto words = [this]() { return std::vector<unsigned long long>(m_wordCount); };
+        auto set = [](std::vector<unsigned long long>::iterator mask, int position) { mask[position / 64] |= 1ULL << (position % 64); };
+        m_first = words();
+        for (auto* position : firstPositions)
+        {
+            auto iter = numbers.find(position);
+            if (iter != numbers.end())
+                set(m_first.begin(), iter->second);
+        }
+        m_byteMasks.resize(256 * m_wordCount);
+        std::map<int, std::vector<unsigned long long>> accepts;
+        std::vector<std::vector<unsigned long long>> followMasks;
+        for (int p = 0; p < m_positionCount; p++)
+        {
+            bool members[256];
+            getMembers(*positions[p]->getValuesSet(), members);
+            for (int c = 0; c < 256; c++)
+            {
+                if (members[c])
+                    set(m_byteMasks.begin() + c * m_wordCount, p);
+            }
+            followMasks.push_back(words());
+            auto range = follows.get(positions[p]);
+            for (auto* next = range.first; next != range.second; next++)
+            {
+                if (auto* end = dynamic_cast<EndNode*>(*next))
+                {
+                    auto iter = accepts.emplace(end->getIdLexAccepted(), words()).first;
+                    set(iter->second.begin(), p);
+                }
+                else
+                    set(followMasks.back().begin(), numbers[*next]);
+            }
+        }
+        m_accepts.assign(accepts.begin(), accepts.end());
+
+        // for each byte of a mask, the union of the follow masks of its positions
+        auto chunkCount = m_wordCount * 8;
+        m_follows.resize((std::size_t)chunkCount * 256 * m_wordCount);
+        for (int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            for (int value = 1; value < 256; value++)
+            {
+                auto* mask = &m_follows[((std::size_t)chunk * 256 + value) * m_wordCount];
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    auto p = chunk * 8 + bit;
+                    if ((value & (1 << bit)) && p < m_positionCount)
+                    {
+                        for (int w = 0; w < m_wordCount; w++)
+                            mask[w] |= followMasks[p][w];
+                    }
+                }
+            }
+        }
+    }
+
+    bool PositionAutomaton::canStart(int c) const
+    {
+        for (int w = 0; w < m_wordCount; w++)
+        {
+            if (m_first[w] & m_byteMasks[c * m_wordCount + w])
+                return true;
+        }
+        return false;
+    }
+
+    int PositionAutomaton::longestMatch(const char* begin, const char* end, std::size_t& length) const
+    {
+        int lexeme = -1;
+        length = 0;
+        std::vector<unsigned long long> reached(m_first), next(m_wordCount);
+        for (const char* p = begin; p != end; p++)
+        {
+            auto c = (unsigned char)*p;
+            unsigned long long any = 0;
+            for (int w = 0; w < m_wordCount; w++)
+            {
+                reached[w] &= m_byteMasks[c * m_wordCount + w];
+                any |= reached[w];
+            }
+            if (!any)
+                break;
+            for (const auto& accept : m_accepts)
+            {
+                unsigned long long hit = 0;
+                for (int w = 0; w < m_wordCount; w++)
+                    hit |= reached[w] & accept.second[w];
+                if (hit)
+                {
+                    lexeme = accept.first;
+                    length = p + 1 - begin;
+                    break;
+                }
+            }
+            std::fill(next.begin(), next.end(), 0ULL);
+            for (int chunk = 0; chunk < m_wordCount * 8; chunk++)
+            {
+                auto value = (reached[chunk / 8] >> (chunk % 8 * 8)) & 0xFF;
+                if (!value)
+                    continue;
+                const auto* mask = &m_follows[((std::size_t)chunk * 256 + value) * m_wordCount];
+                for (int w = 0; w < m_wordCount; w++)
+                    next[w] |= mask[w];
+            }
+            std::swap(reached, next);
+        }
+        return lexeme;
+    }
+
+    std::string PositionAutomaton::toCpp(const std::string& name, const std::string& onFailure) const
+    {
+        std::ostringstream scode;
+        int indent = 2;
+        auto W = std::to_string(m_wordCount);
+        auto noMatch = onFailure.size() ? "if (accepted!=Lexeme::unknown_) return true; goto fail;" : "return (accepted!=Lexeme::unknown_);";
+        auto words = [&scode, this](const unsigned long long* mask)
+        {
+            scode << "{";
+            for (int w = 0; w < m_wordCount; w++)
+            {
+                scode << (w ? "," : "");
+                if (mask[w])
+                    scode << "0x" << std::hex << mask[w] << std::dec << "ULL";
+                else
+                    scode << "0";
+            }
+            scode << "}";
+        };
+
+        INDENT; scode << "bool " << name << "(){" << std::endl; indent++;
+        INDENT; scode << "// bit-parallel simulation of the position automaton of the context (" << m_positionCount << " positions)" << std::endl;
+        INDENT; scode << "static const unsigned long long first[" << W << "] = "; words(m_first.data()); scode << ";" << std::endl;
+        INDENT; scode << "static const unsigned long long byteMasks[256][" << W << "] = {";
+        for (int c = 0; c < 256; c++)
+        {
+            scode << (c ? "," : "");
+            words(&m_byteMasks[c * m_wordCount]);
+        }
+        scode << "};" << std::endl;
+        INDENT; scode << "static const unsigned long long follows[" << m_wordCount * 8 << "][256][" << W << "] = {";
+        for (int chunk = 0; chunk < m_wordCount * 8; chunk++)
+        {
+            scode << (chunk ? ",\n" : "") << "{";
+            for (int value = 0; value < 256; value++)
+            {
+                scode << (value ? "," : "");
+                words(&m_follows[((std::size_t)chunk * 256 + value) * m_wordCount]);
+            }
+            scode << "}";
+        }
+        scode << "};" << std::endl;
+        if (m_accepts.size())
+        {
+            INDENT; scode << "static const struct { int lexeme; unsigned long long mask[" << W << "]; } accepts[" << m_accepts.size() << "] = {";
+            for (std::size_t i = 0; i < m_accepts.size(); i++)
+            {
+                scode << (i ? "," : "") << "{" << m_accepts[i].first << ",";
+                words(m_accepts[i].second.data());
+                scode << "}";
+            }
+            scode << "};" << std::endl;
+        }
+        INDENT; scode << "unsigned long long reached[" << W << "], next[" << W << "];" << std::endl;
+        INDENT; scode << "int c = get(); if (c==Traits::eof()){ accept(Lexeme::eof_); return true;}" << std::endl;
+        INDENT; scode << "for (int w = 0; w < " << W << "; w++)" << std::endl;
+        INDENT; scode << "    reached[w] = first[w];" << std::endl;
+        INDENT; scode << "while (true){" << std::endl; indent++;
+        INDENT; scode << "unsigned long long any = 0;" << std::endl;
+        INDENT; scode << "for (int w = 0; w < " << W << "; w++){" << std::endl;
+        INDENT; scode << "    reached[w] &= byteMasks[c][w];" << std::endl;
+        INDENT; scode << "    any |= reached[w];" << std::endl;
+        INDENT; scode << "}" << std::endl;
+        INDENT; scode << "if (!any){ " << noMatch << "}" << std::endl;
+        if (m_accepts.size())
+        {
+            INDENT; scode << "for (const auto& a : accepts){" << std::endl;
+            INDENT; scode << "    unsigned long long hit = 0;" << std::endl;
+            INDENT; scode << "    for (int w = 0; w < " << W << "; w++)" << std::endl;
+            INDENT; scode << "        hit |= reached[w] & a.mask[w];" << std::endl;
+            INDENT; scode << "    if (hit){ accept((Lexeme)a.lexeme); break;}" << std::endl;
+            INDENT; scode << "}" << std::endl;
+        }
+        INDENT; scode << "c = get(); if (c==Traits::eof()){ " << noMatch << "}" << std::endl;
+        INDENT; scode << "for (int w = 0; w < " << W << "; w++)" << std::endl;
+        INDENT; scode << "    next[w] = 0;" << std::endl;
+        INDENT; scode << "for (int chunk = 0; chunk < " << m_wordCount * 8 << "; chunk++){" << std::endl;
+        INDENT; scode << "    auto value = (reached[chunk / 8] >> (chunk % 8 * 8)) & 0xFF;" << std::endl;
+        INDENT; scode << "    if (value)" << std::endl;
+        INDENT; scode << "        for (int w = 0; w < " << W << "; w++)" << std::endl;
+        INDENT; scode << "            next[w] |= follows[chunk][value][w];" << std::endl;
+        INDENT; scode << "}" << std::endl;
+        INDENT; scode << "for (int w = 0; w < " << W << "; w++)" << std::endl;
+        INDENT; scode << "    reached[w] = next[w];" << std::endl;
+        indent--; INDENT; scode << "}" << std::endl;
+        if (onFailure.size())
+        {
+            indent--;
+            INDENT; scode << "fail:" << std::endl;
+            indent++;
+            INDENT; scode << onFailure << std::endl;
+            INDENT; scode << "return false;" << std::endl;
+        }
+        indent--; INDENT; scode << "}" << std::endl << std::endl;
+        return scode.str();
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    LazyDfa::LazyDfa(const PositionSet& firstPositions, const FollowPositions& follows, std::size_t maxStateCount)
+        :m_follows{ follows }, m_maxStateCount{ std::max<std::size_t>(maxStateCount, 3) }
+    {
+        // the bytes of the positions are tested for each new transition: they are computed once
+        std::vector<CharValueNode*> positions(firstPositions.begin(), firstPositions.end());
+        for (std::size_t i = 0; i < positions.size(); i++)
+        {
+            auto* position = positions[i];
+            if (m_bytes.count(position))
+                continue;
+            auto& bytes = m_bytes[position];
+            bool members[256];
+            getMembers(*position->getValuesSet(), members);
+            for (int c = 0; c < 256; c++)
+                bytes[c] = members[c];
+            auto range = follows.get(position);
+            positions.insert(positions.end(), range.first, range.second);
+        }
+        m_startPositions = PositionSet(firstPositions);
+        addState(PositionSet(firstPositions));
+    }
+
+    int LazyDfa::addState(PositionSet&& positions)
+    {
+        CachedState state;
+        state.acceptedLexeme = -1;
+        for (auto* position : positions)
+        {
+            if (auto* end = dynamic_cast<EndNode*>(position))
+            {
+                if (state.acceptedLexeme < 0 || end->getIdLexAccepted() < state.acceptedLexeme)
+                    state.acceptedLexeme = end->getIdLexAccepted();
+            }
+        }
+        state.next.fill(unknownState);
+        auto id = (int)m_states.size();
+        m_stateIds.emplace(PositionSet(positions), id);
+        state.positions = std::move(positions);
+        m_states.push_back(std::move(state));
+        return id;
+    }
+
+    int LazyDfa::getNextState(int state, unsigned char c)
+    {
+        auto next = m_states[state].next[c];
+        if (next != unknownState)
+            return next;
+
+        PositionSet nextPositions;
+        for (auto* position : m_states[state].positions)
+        {
+            if (!m_bytes[position][c])
+                continue;
+            auto range = m_follows.get(position);
+            nextPositions.insert(range.first, range.second);
+        }
+        if (nextPositions.empty())
+            next = deadState;
+        else
+        {
+            auto iter = m_stateIds.find(nextPositions);
+            if (iter != m_stateIds.end())
+                next = iter->second;
+            else
+            {
+                if (m_states.size() >= m_maxStateCount)
+                {
+                    // the cache is full: it restarts from the start state, still 0, and the current state, whose id changes
+                    auto positions = std::move(m_states[state].positions);
+                    m_states.clear();
+                    m_stateIds.clear();
+                    m_flushCount++;
+                    addState(PositionSet(m_startPositions));
+                    auto iter = m_stateIds.find(positions);
+                    state = (iter != m_stateIds.end()) ? iter->second : addState(std::move(positions));
+                }
+                next = addState(std::move(nextPositions));
+            }
+        }
+        m_states[state].next[c] = next;
+        return next;
+    }
+
+    int LazyDfa::longestMatch(const char* begin, const char* end, std::size_t& length)
+    {
+        int lexeme = -1;
+        length = 0;
+        int state = 0;
+        for (const char* p = begin; p != end; p++)
+        {
+            state = getNextState(state, (unsigned char)*p);
+            if (state == deadState)
+                break;
+            if (m_states[state].acceptedLexeme >= 0)
+            {
+                lexeme = m_states[state].acceptedLexeme;
+                length = p + 1 - begin;
+            }
+        }
+        return lexeme;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
     LexerContext::LexerContext(const std::string& name, int lexemeCount, const std::set<int>& pops)
         :m_pops(pops)
     {
@@ -474,21 +1293,18 @@ namespace RegularExpression
         m_name = std::move(ctx.m_name);
         m_lexemeCount = ctx.m_lexemeCount; ctx.m_lexemeCount = 0;
         m_pops = std::move(ctx.m_pops);
+        m_followPositions = std::move(ctx.m_followPositions);
+        m_firstPositions = std::move(ctx.m_firstPositions);
+        m_automaton = std::move(ctx.m_automaton);
     }
 
     void LexerContext::setExpRegList(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& list)
     {
-        m_phead = std::make_unique<OrNode>(std::move(list));
+        m_phead = makeShared<OrNode>(std::move(list));
     }
 
-    void LexerContext::ComputeLexer()
+    void LexerContext::computePositions()
     {
-        std::vector<State*>   listState;
-        std::map<int, short>  pos2acceptLex;
-
-        if (!m_phead)
-            return;			// !!! ERROR !!!
-
 #ifdef TRACE_EXPREG
         std::ofstream   traceFile;
         traceFile.open("c:\\temp\\exp_reg_tree.txt", std::ios::app);
@@ -496,11 +1312,73 @@ namespace RegularExpression
         traceFile.close();
 #endif
 
-        m_phead->computeFirstPos();
-        m_phead->computeLastPos();
-        const auto &FirstPos = m_phead->getFirstPos();
-        const auto &LastPos = m_phead->getLastPos();
-        m_phead->computeNextPos();
+        m_phead->computeTreePositions(m_followPositions);
+        m_followPositions.build();
+        m_firstPositions = PositionSet(m_phead->getFirstPos());
+        m_phead->releasePositions();
+    }
+
+    std::map<int, std::vector<const CharValueNode*>> LexerContext::getLexemePositions() const
+    {
+        // the positions of each expression are those of its tree and of the copies of its macros, the last one being the
+        // position of its lexeme
+        std::map<int, std::vector<const CharValueNode*>> lexemePositions;
+        std::vector<BaseLexerTreeNode*> expressions;
+        m_phead->getChildren(expressions);
+        for (auto* expression : expressions)
+        {
+            std::vector<BaseLexerTreeNode*> pending{ expression };
+            std::vector<const CharValueNode*> positions;
+            int idLex = -1;
+            while (!pending.empty())
+            {
+                auto* node = pending.back();
+                pending.pop_back();
+                if (auto* end = dynamic_cast<EndNode*>(node))
+                    idLex = end->getIdLexAccepted();
+                else if (auto* position = dynamic_cast<CharValueNode*>(node))
+                    positions.push_back(position);
+                else if (auto* macro = dynamic_cast<MacroNode*>(node))
+                    pending.push_back(&macro->getInstance());
+                node->getChildren(pending);
+            }
+            if (idLex >= 0)
+                lexemePositions[idLex] = std::move(positions);
+        }
+        return lexemePositions;
+    }
+
+    void LexerContext::setIntegerBases(const std::map<int, int>& lexemeBases)
+    {
+        for (const auto& pair : getLexemePositions())
+        {
+            auto iter = lexemeBases.find(pair.first);
+            if (iter == lexemeBases.end())
+                continue;
+            for (auto* position : pair.second)
+                m_positionBases[position] = iter->second;
+        }
+    }
+
+    void LexerContext::setInternedLexemes(const std::set<int>& lexemes)
+    {
+        for (const auto& pair : getLexemePositions())
+        {
+            if (lexemes.count(pair.first))
+                m_hashedPositions.insert(pair.second.begin(), pair.second.end());
+        }
+    }
+
+    bool LexerContext::ComputeLexer(int maxStateCount)
+    {
+        std::vector<State*>   listState;
+        std::map<int, int>    pos2acceptLex;
+
+        if (!m_phead)
+            return true;			// !!! ERROR !!!
+
+        computePositions();
+        const PositionSet& FirstPos = m_firstPositions;
 
         auto iterState = m_mapState.emplace(FirstPos, State(FirstPos,0,-1));
         assert(iterState.second);   // check that starting state was added
@@ -508,11 +1386,26 @@ namespace RegularExpression
         listState.push_back(&initialState);
         do
         {
+            // the transitions of the states of a level are computed in parallel, while the map of states is only read...
+            std::vector<std::vector<std::pair<PositionSet, PositionSet>>> nextPositions(listState.size());
+            std::vector<std::vector<State*>> knownStates(listState.size());
+            parallelFor(listState.size(), [&](std::size_t i)
+                {
+                    nextPositions[i] = listState[i]->ComputeNextPositions(m_followPositions);
+                    for (const auto& pair : nextPositions[i])
+                    {
+                        auto iter = m_mapState.find(pair.first);
+                        knownStates[i].push_back((iter != m_mapState.end()) ? &iter->second : nullptr);
+                    }
+                }, 16);
+
+            // ... then the new states are created in the order of the sequential algorithm, which keeps the numbering of the states
             std::vector<State*>   newStates;
-            for (auto *state : listState)
+            for (std::size_t i = 0; i < listState.size(); i++)
             {
-                state->ComputeNextStates(m_mapState, newStates);
-                m_states.push_back(state);
+                m_states.push_back(listState[i]);
+                if (!listState[i]->ComputeNextStates(nextPositions[i], knownStates[i], m_mapState, newStates, (std::size_t)std::max(maxStateCount, 0)))
+                    return false;
             }
             listState = std::move(newStates);
         } while (listState.size());
@@ -575,6 +1468,7 @@ namespace RegularExpression
                 s->incrRefCount();
             }
         }
+        return true;
     }
 
     BaseLexerTreeNode *LexerContext::GetExprTree()
@@ -582,7 +1476,7 @@ namespace RegularExpression
         return m_phead.get();
     }
 
-    const std::map<PositionSet, State>& LexerContext::getMapState() const
+    const std::unordered_map<PositionSet, State>& LexerContext::getMapState() const
     {
         return m_mapState;
     }
@@ -597,22 +1491,277 @@ namespace RegularExpression
         return scode.str();
     }
 
-    std::string LexerContext::bodyToCpp(const std::string& onFailure, const std::map<int, std::string>& id2OnMatchCode) const
+    bool LexerContext::usePositionAutomaton()
+    {
+        auto automaton = std::make_unique<PositionAutomaton>(m_firstPositions, m_followPositions);
+        if (automaton->getPositionCount() > PositionAutomaton::maxPositionCount)
+            return false;
+        m_automaton = std::move(automaton);
+        m_states.clear();
+        m_mapState.clear();
+        return true;
+    }
+
+    int LexerContext::getTransitionCount() const
+    {
+        int count = 0;
+        for (auto* state : getStates())
+            count += (int)state->getTransitions().size();
+        return count;
+    }
+
+    std::string LexerContext::candidateFinderToCpp() const
+    {
+        std::ostringstream scode;
+        int indent = 2;
+        std::vector<std::pair<int, int>> firstRanges;
+        std::vector<char> firsts(256);
+        if (m_automaton)
+        {
+            for (int c = 0; c < 256; c++)
+            {
+                if (!m_automaton->canStart(c))
+                    continue;
+                firsts[c] = true;
+                if (firstRanges.size() && firstRanges.back().second == c - 1)
+                    firstRanges.back().second = c;
+                else
+                    firstRanges.emplace_back(c, c);
+            }
+        }
+        else if (getStates().size())
+        {
+            auto byteTransitions = getStates()[0]->getByteTransitions();
+            for (int c = 0; c < 256; c++)
+            {
+                if (byteTransitions[c] < 0)
+                    continue;
+                firsts[c] = true;
+                if (firstRanges.size() && firstRanges.back().second == c - 1)
+                    firstRanges.back().second = c;
+                else
+                    firstRanges.emplace_back(c, c);
+            }
+        }
+
+        INDENT; scode << "static const char* findCandidate(const char* begin, const char* end)" << std::endl;
+        INDENT; scode << "{" << std::endl; indent++;
+        if (firstRanges.empty())
+        {
+            INDENT; scode << "return end;" << std::endl;
+        }
+        else if (firstRanges.size() == 1 && firstRanges[0].first == firstRanges[0].second)
+        {
+            INDENT; scode << "auto candidate = std::memchr(begin, " << firstRanges[0].first << ", end - begin);" << std::endl;
+            INDENT; scode << "return candidate ? static_cast<const char*>(candidate) : end;" << std::endl;
+        }
+        else
+        {
+            auto classifier = runClassifierToCpp(firstRanges);
+            if (classifier.size())
+            {
+                scode << "#if NANOLEXER_SIMD" << std::endl;
+                INDENT; scode << "auto inSet = " << classifier << ";" << std::endl;
+                INDENT; scode << "for (; end - begin >= 64; begin += 64)" << std::endl;
+                INDENT; scode << "{" << std::endl; indent++;
+                INDENT; scode << "if (auto m = inSet(begin))" << std::endl;
+                INDENT; scode << "    return begin + countTrailingZeros(m);" << std::endl;
+                indent--; INDENT; scode << "}" << std::endl;
+                scode << "#endif" << std::endl;
+            }
+            INDENT; scode << "static const bool candidates[256] = {";
+            for (int c = 0; c < 256; c++)
+                scode << (c ? "," : "") << (firsts[c] ? "1" : "0");
+            scode << "};" << std::endl;
+            INDENT; scode << "while (begin != end && !candidates[(unsigned char)*begin])" << std::endl;
+            INDENT; scode << "    begin++;" << std::endl;
+            INDENT; scode << "return begin;" << std::endl;
+        }
+        indent--; INDENT; scode << "}" << std::endl;
+        return scode.str();
+    }
+
+    std::string LexerContext::scanStepsToCpp() const
     {
+        std::ostringstream scode;
+        int indent = 2;
+        // for each state, the index of the next state on each byte (-1 if none)
+        std::vector<std::vector<int>> stateTargets;
+        std::vector<char> accepts;
+        if (m_automaton)
+        {
+            // the attempts are not simulated together: each byte that can start a match is a possible one
+            stateTargets.emplace_back(256, -1);
+            for (int c = 0; c < 256; c++)
+            {
+                if (m_automaton->canStart(c))
+                    stateTargets[0][c] = 0;
+            }
+            accepts.push_back(true);
+        }
+        else
+        {
+            const auto& states = getStates();
+            std::map<const State*, int> indexes;
+            for (const auto* state : states)
+                indexes.emplace(state, (int)indexes.size());
+            for (const auto* state : states)
+            {
+                auto targets = state->getByteTransitions();
+                for (auto& target : targets)
+                {
+                    if (target >= 0)
+                        target = indexes[state->getTransitions()[target].second];
+                }
+                stateTargets.push_back(std::move(targets));
+                accepts.push_back(state->getIdLexAccepted() >= 0);
+            }
+        }
+        // the bytes leading to the same state from every state share a class, as for the computed goto
+        std::vector<int> byteClasses;
+        std::map<std::vector<int>, int> classes;
+        for (int c = 0; c < 256; c++)
+        {
+            std::vector<int> signature;
+            for (const auto& targets : stateTargets)
+                signature.push_back(targets[c]);
+            byteClasses.push_back(classes.emplace(std::move(signature), (int)classes.size()).first->second);
+        }
+        std::vector<std::vector<int>> classTargets(classes.size());
+        for (const auto& pair : classes)
+            classTargets[pair.second] = pair.first;
+        auto stateCount = stateTargets.size();
+        auto nextType = (stateCount + 1 <= 0xFF) ? "unsigned char" : (stateCount + 1 <= 0xFFFF) ? "unsigned short" : "unsigned int";
+
+        INDENT; scode << "static constexpr int scanStateCount = " << stateCount << ";" << std::endl;
+        scode << std::endl;
+        INDENT; scode << "// next state of the main context DFA from 'state' on byte 'c', or -1" << std::endl;
+        INDENT; scode << "static int scanStep(int state, int c)" << std::endl;
+        INDENT; scode << "{" << std::endl; indent++;
+        INDENT; scode << "static const unsigned char classes[256] = {";
+        for (int c = 0; c < 256; c++)
+            scode << (c ? "," : "") << byteClasses[c];
+        scode << "};" << std::endl;
+        INDENT; scode << "// index of the next state plus 1, by state and class" << std::endl;
+        INDENT; scode << "static const " << nextType << " next[" << std::max<std::size_t>(stateCount, 1) << "][" << classes.size() << "] = {";
+        for (std::size_t i = 0; i < stateCount; i++)
+        {
+            scode << (i ? ",{" : "{");
+            for (std::size_t k = 0; k < classTargets.size(); k++)
+                scode << (k ? "," : "") << classTargets[k][i] + 1;
+            scode << "}";
+        }
+        scode << "};" << std::endl;
+        INDENT; scode << "return (int)next[state][classes[c]] - 1;" << std::endl;
+        indent--; INDENT; scode << "}" << std::endl;
+        scode << std::endl;
+        INDENT; scode << "static bool scanAccepts(int state)" << std::endl;
+        INDENT; scode << "{" << std::endl; indent++;
+        INDENT; scode << "static const bool accepts[" << std::max<std::size_t>(stateCount, 1) << "] = {";
+        for (std::size_t i = 0; i < stateCount; i++)
+            scode << (i ? "," : "") << (accepts[i] ? "1" : "0");
+        scode << "};" << std::endl;
+        INDENT; scode << "return accepts[state];" << std::endl;
+        indent--; INDENT; scode << "}" << std::endl;
+        return scode.str();
+    }
+
+    std::string LexerContext::bodyToCpp(const std::string& onFailure, const std::map<int, std::string>& id2OnMatchCode, int firstCounter, const ContextProfile* profile, bool computedGoto, bool runScan) const
+    {
+        if (m_automaton)
+            return m_automaton->toCpp(m_name, onFailure);
+        std::set<int> bases;
+        for (const auto& pair : m_positionBases)
+            bases.insert(pair.second);
+
         std::ostringstream scode;
         int indent = 2;
         int cpt = 0;
         auto isMainContext = (m_pops.size() == 0);
 
-        INDENT; scode << "bool " << m_name << "(){" << std::endl; indent++;
+        // the counters of the transitions are numbered in the order of the states, whatever the order of their code
+        std::vector<std::pair<const State*, int>> states;
+        auto counter = firstCounter;
         for (auto* state : getStates())
         {
             if (state->getTransitions().size())
             {
-                scode << state->toCpp(m_pops, m_mapPush, id2OnMatchCode, m_lexemeCount>m_pops.size(), onFailure.size()>0);
-                cpt++;
+                states.emplace_back(state, counter);
+                if (firstCounter >= 0)
+                    counter += (int)state->getTransitions().size();
             }
         }
+        auto countsOf = [profile](const State* state) -> const std::vector<unsigned long long>*
+        {
+            if (!profile)
+                return nullptr;
+            auto iter = profile->find(state->GetId());
+            return (iter != profile->end()) ? &iter->second : nullptr;
+        };
+        if (profile)
+        {
+            // the most visited states first, state 0 staying the first one as it declares 'c'
+            auto visits = [&countsOf](const State* state)
+            {
+                unsigned long long count = 0;
+                if (auto* counts = countsOf(state))
+                {
+                    for (auto n : *counts)
+                        count += n;
+                }
+                return count;
+            };
+            std::stable_sort(states.begin(), states.end(), [&visits](const std::pair<const State*, int>& a, const std::pair<const State*, int>& b)
+                {
+                    if ((a.first->GetId() == 0) != (b.first->GetId() == 0))
+                        return a.first->GetId() == 0;
+                    return visits(a.first) > visits(b.first);
+                });
+        }
+
+        INDENT; scode << "bool " << m_name << "(){" << std::endl; indent++;
+        for (auto base : bases)
+        {
+            INDENT; scode << "integerAccumulator" << base << " = 0;" << std::endl;
+        }
+        if (m_hashedPositions.size())
+        {
+            INDENT; scode << "symbolHashAccumulator = 2166136261u;" << std::endl;
+        }
+        std::vector<int> byteClasses;
+        if (computedGoto)
+        {
+            // the bytes taking the same transition in every state share a class, which indexes the dispatch tables
+            std::vector<std::vector<int>> stateTransitions;
+            for (const auto& pair : states)
+                stateTransitions.push_back(pair.first->getByteTransitions());
+            std::map<std::vector<int>, int> classes;
+            for (int c = 0; c < 256; c++)
+            {
+                std::vector<int> signature;
+                for (const auto& byteTransitions : stateTransitions)
+                    signature.push_back(byteTransitions[c]);
+                byteClasses.push_back(classes.emplace(std::move(signature), (int)classes.size()).first->second);
+            }
+            scode << "#if NANOLEXER_COMPUTED_GOTO" << std::endl;
+            INDENT; scode << "static const unsigned char charClasses[256] = {";
+            for (int c = 0; c < 256; c++)
+                scode << (c ? "," : "") << byteClasses[c];
+            scode << "};" << std::endl;
+            scode << "#endif" << std::endl;
+        }
+        StateCodeOptions options{ m_pops, m_mapPush, id2OnMatchCode };
+        options.withNoread = (std::size_t)m_lexemeCount > m_pops.size();
+        options.withOnFailure = onFailure.size() > 0;
+        options.byteClasses = computedGoto ? &byteClasses : nullptr;
+        options.runScan = runScan;
+        options.positionBases = m_positionBases.empty() ? nullptr : &m_positionBases;
+        options.hashedPositions = m_hashedPositions.empty() ? nullptr : &m_hashedPositions;
+        for (const auto& pair : states)
+        {
+            scode << pair.first->toCpp(options, pair.second, countsOf(pair.first));
+            cpt++;
+        }
         indent--;
         if (isMainContext)
         {
@@ -657,6 +1806,8 @@ namespace RegularExpression
     std::string LexerContext::getDebugString(const std::set<int>& popIds) const
     {
         std::string debug;
+        if (m_automaton)
+            debug += "position automaton of " + std::to_string(m_automaton->getPositionCount()) + " positions\n";
         for (auto state : getStates())
         {
             if (state->getTransitions().size())
@@ -5,6 +5,8 @@
 #include <functional>
 #include <vector>
 #include <sstream>
+#include <array>
+#include <bitset>
 
 #define T_EXPRTREE	1
 
@@ -30,33 +32,71 @@ namespace RegularExpression
 {
     extern std::fstream		f_Unit_Lexer;
 
+    // Calls task(i) for each i in [0, count[ on a pool of threads (as many as the hardware supports, with at least
+    // 'grain' tasks per thread). The tasks must store their results by index so that the output does not depend on 
+    // the scheduling. The first exception thrown by a task is rethrown once all the threads are done.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task, std::size_t grain = 1);
+
     typedef std::unordered_set<CHARSET_TYPE>   SET_CHAR;
 
+    // Transition counts of a context read from a profile (see LexerGenerator::setProfile()): for each state id, the
+    // number of times each of its transitions was taken, by index in State::getTransitions().
+    using ContextProfile = std::map<int, std::vector<unsigned long long>>;
+
     class LexerContext;
+
+    // Options of the code generated for the states of a context, the same for all of them (see State::toCpp())
+    struct StateCodeOptions
+    {
+        const std::set<int>&                    pops;               // lexemes popping the context, none for the main one
+        const std::map<int, LexerContext*>&     pushCtx;            // context pushed by each lexeme
+        const std::map<int, std::string>&       id2OnMatchCode;     // code run on the match of each lexeme
+        bool                                    withNoread = false; // the context has lexemes that do not pop it
+        bool                                    withOnFailure = false;  // a failure jumps to the label fail
+        // the class of each byte: the code also dispatches with a computed goto on the class of the byte when
+        // NANOLEXER_COMPUTED_GOTO is set
+        const std::vector<int>*                 byteClasses = nullptr;
+        // a state looping on a few ranges of bytes first consumes their run with skipRun(), by blocks of 64 bytes
+        // classified with SSE2, when NANOLEXER_SIMD is set
+        bool                                    runScan = false;
+        // the transitions add the digits they consume to the integer values of the bases of their positions
+        const std::map<const CharValueNode*, int>*  positionBases = nullptr;
+        // the transitions consuming a byte with one of these positions add it to symbolHashAccumulator
+        const std::set<const CharValueNode*>*   hashedPositions = nullptr;
+    };
+
     class State
     {
         PositionSet      m_positions;
-        short       m_ident;
+        int         m_ident;
         std::vector<std::pair<PositionSet, State*>>    m_transitions;     // vector expression, state
-        short       m_idLexAccepted;      // -1 if none
-        short       m_nbRef;
+        int         m_idLexAccepted;      // -1 if none
+        int         m_nbRef;
 
-        void printAction(bool isMainContext, std::ostringstream& scode, const State* nextState, const std::set<int>& pops, const std::map<int, LexerContext*>& pushCtx, const std::map<int, std::string>& id2OnMatchCode, bool withOnFailure) const;
+        void printAction(bool isMainContext, std::ostringstream& scode, const State* nextState, const StateCodeOptions& options) const;
     public:
-        State(const PositionSet &a, short id, short acceptLex);
+        State(const PositionSet &a, int id, int acceptLex);
         State(const State&) = delete;
         State(State&& s) noexcept;
 
         bool operator==(const State& s) const;
 
-        void    ComputeNextStates(std::map<PositionSet, State>&   m_mapState, std::vector<State*>&   listState);
+        // Returns the pairs (positions of the next state, expression) of the transitions of the state, 'follows' being the
+        // followpos of the context. Does not modify anything, so that the states of a same level of the DFA are computed 
+        // in parallel.
+        std::vector<std::pair<PositionSet, PositionSet>> ComputeNextPositions(const FollowPositions& follows) const;
+        // Creates the transitions from the result of ComputeNextPositions(). 'knownStates' gives for each transition the 
+        // state found in 'mapState' before the level was processed, or nullptr. New states are numbered in order of 
+        // creation and added to 'listState'. Returns false, before creating it, when a new state would make 'mapState'
+        // larger than 'maxStateCount' (0 for no limit).
+        bool    ComputeNextStates(const std::vector<std::pair<PositionSet, PositionSet>>& nextPositions, const std::vector<State*>& knownStates, std::unordered_map<PositionSet, State>&   mapState, std::vector<State*>&   listState, std::size_t maxStateCount = 0);
         bool    removeRedundantTransitions();
         bool    replace(const State* oldState, State* newState);
         std::string toDebugString(const std::set<int>& pops) const;
 
-        inline short GetId() const { return m_ident; }
-        inline void setIdLexAccepted(short idLex) { if (m_idLexAccepted == -1 || idLex < m_idLexAccepted) m_idLexAccepted = idLex; }
-        inline short getIdLexAccepted() const { return m_idLexAccepted; }
+        inline int GetId() const { return m_ident; }
+        inline void setIdLexAccepted(int idLex) { if (m_idLexAccepted == -1 || idLex < m_idLexAccepted) m_idLexAccepted = idLex; }
+        inline int getIdLexAccepted() const { return m_idLexAccepted; }
         inline void incrRefCount() { m_nbRef++; }
         inline bool isReferenced() const { return m_nbRef > 0; }
 
@@ -65,16 +105,96 @@ namespace RegularExpression
 
         bool HasNextStateAsAcceptState() const;
         bool IsRecursiveState() const;
-        std::string toCpp(const std::set<int>& pops, const std::map<int, LexerContext*>& pushCtx, const std::map<int, std::string>& id2OnMatchCode, bool withNoread, bool withOnFailure) const;
+        // True for an accepting state whose transitions all lead to accepting states, without pushing a context: the
+        // input is never backtracked into it, so its lexeme is accepted only when the state is left without a transition.
+        bool acceptsOnExit(const std::map<int, LexerContext*>& pushCtx) const;
+        // Returns for each byte the index of the transition it takes (-1 if none), as tested by the code of the state.
+        std::vector<int> getByteTransitions() const;
+        // 'firstCounter' is the index of the profile counter of the first transition (-1 if the code is not instrumented).
+        // With 'counts', the transitions are tested by decreasing frequency and those never taken are marked unlikely.
+        std::string toCpp(const StateCodeOptions& options, int firstCounter = -1, const std::vector<unsigned long long>* counts = nullptr) const;
+    };
+
+    // Position (Glushkov) automaton of a context, simulated bit-parallel: the positions reached after each byte are the
+    // bits of a mask of 64-bit words, and the positions that may follow them are looked up by bytes of this mask. Unlike
+    // the DFA, which may explode, its tables are quadratic in the number of positions whatever the expressions.
+    class PositionAutomaton
+    {
+        int     m_positionCount = 0;
+        int     m_wordCount = 0;
+        std::vector<unsigned long long>     m_first;        // positions that may start a match
+        std::vector<unsigned long long>     m_byteMasks;    // positions matching each byte, at [byte * m_wordCount + word]
+        std::vector<unsigned long long>     m_follows;      // positions that may follow the positions set in the byte 'chunk' of
+                                                            // a mask, when it is 'value', at [(chunk * 256 + value) * m_wordCount + word]
+        std::vector<std::pair<int, std::vector<unsigned long long>>>    m_accepts;  // positions after which each lexeme is
+                                                                                    // accepted, by increasing lexeme id
+    public:
+        static constexpr int maxPositionCount = 256;
+
+        // The positions are those reachable from 'firstPositions' in 'follows' (at most maxPositionCount).
+        PositionAutomaton(const PositionSet& firstPositions, const FollowPositions& follows);
+
+        inline int getPositionCount() const { return m_positionCount; }
+        // True when a match may start with byte c.
+        bool canStart(int c) const;
+        // Returns the id of the lexeme of the longest match at the start of [begin, end) (the first one declared when
+        // several lexemes match it) and sets 'length' to its length. Returns -1 when nothing matches.
+        int longestMatch(const char* begin, const char* end, std::size_t& length) const;
+        // Code of the method 'name' simulating the automaton, with the same contract as the code generated from a DFA
+        // for a main context without push action: 'onFailure' is run when nothing matches.
+        std::string toCpp(const std::string& name, const std::string& onFailure) const;
+    };
+
+    // DFA of a context built lazily, while matching: a state is created when the input first reaches it, from the
+    // positions of the state it comes from, and its transitions are computed byte by byte. The states are cached up to
+    // a maximum count; the cache is flushed when it is full. Memory stays bounded whatever the size of the full DFA.
+    class LazyDfa
+    {
+        static constexpr int unknownState = -2;     // transition not computed yet
+        static constexpr int deadState = -1;
+
+        struct CachedState
+        {
+            PositionSet             positions;
+            int                     acceptedLexeme;     // -1 if none
+            std::array<int, 256>    next;               // by byte: id of the next state, deadState or unknownState
+        };
+
+        const FollowPositions&      m_follows;
+        std::size_t                 m_maxStateCount;
+        std::size_t                 m_flushCount = 0;
+        PositionSet                 m_startPositions;
+        std::unordered_map<const CharValueNode*, std::bitset<256>>  m_bytes;     // bytes matched by each position
+        std::vector<CachedState>                        m_states;
+        std::unordered_map<PositionSet, int>            m_stateIds;
+
+        int addState(PositionSet&& positions);
+        int getNextState(int state, unsigned char c);
+
+    public:
+        // 'firstPositions' and 'follows' are those of a context (see LexerContext::computePositions()), which must
+        // outlive the DFA. At most 'maxStateCount' states (3 or more) are cached; the start state is always the state 0.
+        LazyDfa(const PositionSet& firstPositions, const FollowPositions& follows, std::size_t maxStateCount);
+
+        inline std::size_t getStateCount() const { return m_states.size(); }
+        inline std::size_t getFlushCount() const { return m_flushCount; }
+        // Returns the id of the lexeme of the longest match at the start of [begin, end) (the first one declared when
+        // several lexemes match it) and sets 'length' to its length. Returns -1 when nothing matches.
+        int longestMatch(const char* begin, const char* end, std::size_t& length);
     };
 
     class LexerContext
     {
-        std::unique_ptr<BaseLexerTreeNode>	m_phead;
-        std::map<PositionSet, State>        m_mapState;
+        std::shared_ptr<BaseLexerTreeNode>	m_phead;
+        FollowPositions                     m_followPositions;
+        PositionSet                         m_firstPositions;
+        std::unique_ptr<PositionAutomaton>  m_automaton;        // replaces the DFA when set
+        std::map<const CharValueNode*, int> m_positionBases;    // base of the integer value of the positions, see setIntegerBases()
+        std::set<const CharValueNode*>      m_hashedPositions;  // see setInternedLexemes()
+        std::unordered_map<PositionSet, State>  m_mapState;
         std::vector<State*>                 m_states;
 
-        std::vector<short>			m_AcceptState;		// array of accept state. lenght of array = number of states.
+        std::vector<int>			m_AcceptState;		// array of accept state. lenght of array = number of states.
         // if m_AcceptState[i]=0 => the state i is not an accept state
         // if m_AcceptState[i]=n => the state i is an accept state for the lexeme of id n.
 
@@ -84,6 +204,9 @@ namespace RegularExpression
         std::map<int, LexerContext*>    m_mapPush;  // lexeme id => context to be pushed
         std::string     onMatchCode;
 
+        // positions of the expression of each lexeme (by id)
+        std::map<int, std::vector<const CharValueNode*>> getLexemePositions() const;
+
     public:
         LexerContext(const std::string& name, int lexemeCount, const std::set<int>& pops);
         LexerContext(const LexerContext& ctx) = delete;
@@ -95,14 +218,45 @@ namespace RegularExpression
         inline void addPushContext(int idLex, LexerContext* ctx) { m_mapPush.emplace(idLex, ctx); }
 
         void setExpRegList(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& list);
+        // Makes the code of the context compute the integer value of the lexemes of 'lexemeBases' (lexeme id => base)
+        // while they are matched: the digits of the base consumed by their positions are accumulated in
+        // integerAccumulator<base>, reset at the start of the context.
+        void setIntegerBases(const std::map<int, int>& lexemeBases);
+        // Makes the code of the context hash the lexemes of 'lexemes' while they are matched (FNV-1a of their bytes, in
+        // symbolHashAccumulator, reset at the start of the context).
+        void setInternedLexemes(const std::set<int>& lexemes);
         void addExpression(std::shared_ptr<BaseLexerTreeNode> expr);
 
-        void ComputeLexer();
+        // Computes the DFA of the context. Returns false, with an incomplete DFA, when it has more than 'maxStateCount'
+        // states (0 for no limit).
+        bool ComputeLexer(int maxStateCount = 0);
+        // Computes the first positions and the followpos of the context, the first step of ComputeLexer(). Alone, it
+        // prepares the context for a LazyDfa.
+        void computePositions();
+        inline const PositionSet& getFirstPositions() const { return m_firstPositions; }
+        inline const FollowPositions& getFollowPositions() const { return m_followPositions; }
+        // Replaces the DFA, incomplete or not, with the position automaton of the context. Returns false when it has too
+        // many positions (see PositionAutomaton::maxPositionCount).
+        bool usePositionAutomaton();
+        inline const PositionAutomaton* getPositionAutomaton() const { return m_automaton.get(); }
 
         BaseLexerTreeNode *GetExprTree();
-        const std::map<PositionSet, State>& getMapState() const;
+        const std::unordered_map<PositionSet, State>& getMapState() const;
         std::string declareToCpp() const;
-        std::string bodyToCpp(const std::string& onFailure, const std::map<int, std::string>& id2OnMatchCode) const;
+        // Number of transitions of the states, i.e. of profile counters of the context when the code is instrumented.
+        int getTransitionCount() const;
+        // 'firstCounter' is the index of the first profile counter of the context (-1 if the code is not instrumented).
+        // With a 'profile', the most visited states are placed first (after state 0). With 'computedGoto', the states also
+        // dispatch on the class of the byte read with a table of labels, and with 'runScan' they skip the runs of the bytes
+        // they loop on, see State::toCpp().
+        std::string bodyToCpp(const std::string& onFailure, const std::map<int, std::string>& id2OnMatchCode, int firstCounter = -1, const ContextProfile* profile = nullptr, bool computedGoto = false, bool runScan = false) const;
+        // Static method findCandidate(begin, end) returning the first byte that can start a match of the context (or end):
+        // memchr for a single first byte, else blocks of 64 bytes classified with SSE2 when NANOLEXER_SIMD is set, then a table.
+        std::string candidateFinderToCpp() const;
+        // Static methods scanStep(state, c) and scanAccepts(state) giving the DFA of the context as tables, indexed by the
+        // position of the states in getStates(), for the search of findNextToken() (see LexerGenerator::setScanMode()).
+        // With a position automaton, a single accepting state stops the search on each byte that can start a match.
+        std::string scanStepsToCpp() const;
         std::string getOnMatchCode();
         std::string getDebugString(const std::set<int>& popIds) const;
     };
@@ -1,6 +1,7 @@
 #include "LexerTreeNode.h"
 
 #include <cassert>
+#include <algorithm>
 #include <string>
 
 namespace std
@@ -34,6 +35,32 @@ namespace std
 
 namespace RegularExpression
 {
+    namespace
+    {
+        // ids reserved by the reference to a macro, given to the positions of its copy
+        struct ReservedIds
+        {
+            int next = 0;
+            int end = 0;
+        };
+        thread_local ReservedIds reservedIds;
+
+        struct ReservedIdsScope
+        {
+            ReservedIds previous;
+
+            ReservedIdsScope(int first, int count) :previous(reservedIds)
+            {
+                reservedIds.next = first;
+                reservedIds.end = first + count;
+            }
+            ~ReservedIdsScope()
+            {
+                reservedIds = previous;
+            }
+        };
+    }
+
     std::string char2stringExpr(unsigned char v)
     {
         switch (v)
@@ -64,6 +91,174 @@ namespace RegularExpression
         }
     }
 
+    ///////////////////////////////////////////////////////////////
+    //	class NodeArena
+
+    namespace
+    {
+        thread_local NodeArena* currentArena = nullptr;
+        thread_local std::pmr::memory_resource* currentBuffer = nullptr;
+    }
+
+    std::pmr::memory_resource* NodeArena::getBuffer()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // a thread id may be reused once its thread has ended, and so may its buffer
+        auto& buffer = m_buffers[std::this_thread::get_id()];
+        if (!buffer)
+            buffer = std::make_unique<std::pmr::monotonic_buffer_resource>();
+        return buffer.get();
+    }
+
+    NodeArena* NodeArena::getCurrent()
+    {
+        return currentArena;
+    }
+
+    std::pmr::memory_resource* NodeArena::getCurrentBuffer()
+    {
+        return currentBuffer ? currentBuffer : std::pmr::new_delete_resource();
+    }
+
+    ArenaScope::ArenaScope(NodeArena* arena)
+        :m_previous(currentArena), m_previousBuffer(currentBuffer)
+    {
+        currentArena = arena;
+        currentBuffer = arena ? arena->getBuffer() : nullptr;
+    }
+
+    ArenaScope::~ArenaScope()
+    {
+        currentArena = m_previous;
+        currentBuffer = m_previousBuffer;
+    }
+
+    ///////////////////////////////////////////////////////////////
+    //	class FollowPositions
+
+    void FollowPositions::add(const PositionSet& from, const PositionSet& to)
+    {
+        for (auto* position : from)
+        {
+            for (auto* next : to)
+                m_edges.emplace_back(position, next);
+        }
+    }
+
+    void FollowPositions::build()
+    {
+        std::less<CharValueNode*> byId;
+        std::sort(m_edges.begin(), m_edges.end(), [&byId](const auto& lhs, const auto& rhs)
+            {
+                if (lhs.first != rhs.first)
+                    return byId(lhs.first, rhs.first);
+                return byId(lhs.second, rhs.second);
+            });
+        m_edges.erase(std::unique(m_edges.begin(), m_edges.end()), m_edges.end());
+
+        m_follows.reserve(m_edges.size());
+        CharValueNode* previous = nullptr;
+        for (const auto& edge : m_edges)
+        {
+            if (edge.first != previous)
+            {
+                edge.first->followIndex = (int)m_offsets.size();
+                m_offsets.push_back((int)m_follows.size());
+                previous = edge.first;
+            }
+            m_follows.push_back(edge.second);
+        }
+        m_offsets.push_back((int)m_follows.size());
+
+        m_edges.clear();
+        m_edges.shrink_to_fit();
+    }
+
+    std::pair<CharValueNode* const*, CharValueNode* const*> FollowPositions::get(const CharValueNode* position) const
+    {
+        if (position->followIndex < 0)
+            return { nullptr, nullptr };
+        const auto* follows = m_follows.data();
+        return { follows + m_offsets[position->followIndex], follows + m_offsets[position->followIndex + 1] };
+    }
+
+    ///////////////////////////////////////////////////////////////
+    //	class BaseLexerTreeNode
+
+    void BaseLexerTreeNode::getTreeNodes(std::vector<BaseLexerTreeNode*>& nodes)
+    {
+        std::vector<BaseLexerTreeNode*> pending{ this };
+        std::vector<BaseLexerTreeNode*> children;
+        while (!pending.empty())
+        {
+            auto* node = pending.back();
+            pending.pop_back();
+            nodes.push_back(node);
+            children.clear();
+            node->getChildren(children);
+            pending.insert(pending.end(), children.begin(), children.end());
+        }
+    }
+
+    void BaseLexerTreeNode::computeTreePositions(FollowPositions& follows)
+    {
+        std::vector<BaseLexerTreeNode*> nodes;
+        getTreeNodes(nodes);
+
+        // in reverse pre-order, the children of a node are computed before it
+        for (auto iter = nodes.rbegin(); iter != nodes.rend(); iter++)
+        {
+            (*iter)->computePositions(follows);
+        }
+    }
+
+    std::shared_ptr<BaseLexerTreeNode> BaseLexerTreeNode::clone()
+    {
+        std::vector<BaseLexerTreeNode*> nodes;
+        getTreeNodes(nodes);
+
+        // in reverse pre-order, the copies of the children of a node are the last ones made, in order
+        std::vector<std::shared_ptr<BaseLexerTreeNode>> copies;
+        std::vector<BaseLexerTreeNode*> children;
+        for (auto iter = nodes.rbegin(); iter != nodes.rend(); iter++)
+        {
+            children.clear();
+            (*iter)->getChildren(children);
+            auto first = copies.end() - children.size();
+            std::vector<std::shared_ptr<BaseLexerTreeNode>> childCopies(std::make_move_iterator(first), std::make_move_iterator(copies.end()));
+            copies.erase(first, copies.end());
+            copies.push_back((*iter)->cloneNode(std::move(childCopies)));
+        }
+        return copies.back();
+    }
+
+    int BaseLexerTreeNode::getPositionCount()
+    {
+        std::vector<BaseLexerTreeNode*> nodes;
+        getTreeNodes(nodes);
+
+        auto count = 0;
+        for (auto* node : nodes)
+        {
+            count += node->getNodePositionCount();
+        }
+        return count;
+    }
+
+    void BaseLexerTreeNode::releaseTree()
+    {
+        std::vector<std::shared_ptr<BaseLexerTreeNode>> pending;
+        moveChildren(pending);
+        while (!pending.empty())
+        {
+            auto node = std::move(pending.back());
+            pending.pop_back();
+            // the last reference to a node: its children are released here rather than by its destructor
+            if (node.use_count() == 1)
+                node->moveChildren(pending);
+        }
+    }
+
     ///////////////////////////////////////////////////////////////
     //	class PositionSet
 
@@ -94,24 +289,15 @@ namespace RegularExpression
         m_Children.push_back(child);
     }
 
-    bool ConcatNode::nullable()
+    ConcatNode::~ConcatNode()
     {
-        for (const auto &child : m_Children)
-        {
-            if (!child->nullable())
-                return false;
-        }
-        return true;
+        releaseTree();
     }
 
-    std::shared_ptr<BaseLexerTreeNode> ConcatNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> ConcatNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const
     {
-        auto concat = std::make_shared<ConcatNode>();
-        for (auto child : m_Children)
-        {
-            concat->m_Children.push_back(child->clone());
-            assert(m_Children.back());
-        }
+        auto concat = makeShared<ConcatNode>();
+        concat->m_Children = std::move(children);
         return concat;
     }
 
@@ -140,52 +326,40 @@ namespace RegularExpression
         return minLex;
     }
 
-    void ConcatNode::computeNextPos()
+    void ConcatNode::getChildren(std::vector<BaseLexerTreeNode*>& children) const
     {
-        std::vector<BaseLexerTreeNode*> arrayPrevious;
         for (const auto &child : m_Children)
         {
-            for (auto *previous : arrayPrevious)
-            {
-                for (auto &last : previous->getLastPos())
-                {
-                    last->addNext(child->getFirstPos());
-                }
-            }
-            if (!child->nullable())
-                arrayPrevious.clear();
-            arrayPrevious.push_back(child.get());
-            child->computeNextPos();
+            children.push_back(child.get());
         }
     }
 
-    void ConcatNode::computeFirstPos()
+    void ConcatNode::moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children)
     {
-        auto nullable = true;
-        for (const auto &child : m_Children)
-        {
-            child->computeFirstPos();
-            if (nullable)
-                addFirst(child->getFirstPos());
-            if (!child->nullable())
-                nullable = false;
-        }
+        std::move(m_Children.begin(), m_Children.end(), std::back_inserter(children));
+        m_Children.clear();
     }
 
-    void ConcatNode::computeLastPos()
+    void ConcatNode::computePositions(FollowPositions& follows)
     {
+        // last positions of the children that may precede the current child
+        PositionSet previousLast;
         auto nullable = true;
-        for (auto iter = m_Children.rbegin()
-            ; iter != m_Children.rend()
-            ; iter++)
+        for (const auto &child : m_Children)
         {
-            const auto &child = *iter;
-            child->computeLastPos();
+            follows.add(previousLast, child->getFirstPos());
             if (nullable)
-                addLast(child->getLastPos());
+                addFirst(child->getFirstPos());
             if (!child->nullable())
+            {
                 nullable = false;
+                previousLast.clear();
+            }
+            previousLast.insert(child->getLastPos().begin(), child->getLastPos().end());
+            child->releasePositions();
         }
+        addLast(previousLast);
+        m_nullable = nullable;
     }
 
 #ifdef TRACE_EXPREG
@@ -193,7 +367,7 @@ namespace RegularExpression
     {
         for (int i = 0; i < indent; i++)
             str << "    ";
-        str << "node CONCAT" << "    First(" << m_FirstPos.toDebugIdList() << ")    Next(" << m_NextPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
+        str << "node CONCAT" << "    First(" << m_FirstPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
         for (auto child : m_Children)
         {
             child->trace(str, indent + 1);
@@ -218,23 +392,15 @@ namespace RegularExpression
         m_Children.push_back(child);
     }
 
-    bool OrNode::nullable()
+    OrNode::~OrNode()
     {
-        for (const auto &child : m_Children)
-        {
-            if (child->nullable())
-                return true;
-        }
-        return false;
+        releaseTree();
     }
 
-    std::shared_ptr<BaseLexerTreeNode> OrNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> OrNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const
     {
-        auto node = std::make_shared<OrNode>();
-        for (auto child : m_Children)
-        {
-            node->m_Children.push_back(child->clone());
-        }
+        auto node = makeShared<OrNode>();
+        node->m_Children = std::move(children);
         return node;
     }
 
@@ -263,29 +429,28 @@ namespace RegularExpression
         return minLex;
     }
 
-    void OrNode::computeNextPos()
+    void OrNode::getChildren(std::vector<BaseLexerTreeNode*>& children) const
     {
         for (const auto &child : m_Children)
         {
-            child->computeNextPos();
+            children.push_back(child.get());
         }
     }
 
-    void OrNode::computeFirstPos()
+    void OrNode::moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children)
     {
-        for (const auto &child : m_Children)
-        {
-            child->computeFirstPos();
-            addFirst(child->getFirstPos());
-        }
+        std::move(m_Children.begin(), m_Children.end(), std::back_inserter(children));
+        m_Children.clear();
     }
 
-    void OrNode::computeLastPos()
+    void OrNode::computePositions(FollowPositions& /*follows*/)
     {
         for (const auto &child : m_Children)
         {
-            child->computeLastPos();
+            addFirst(child->getFirstPos());
             addLast(child->getLastPos());
+            m_nullable = m_nullable || child->nullable();
+            child->releasePositions();
         }
     }
 
@@ -294,7 +459,7 @@ namespace RegularExpression
     {
         for (int i = 0; i < indent; i++)
             str << "    ";
-        str << "node OR" << "    First(" << m_FirstPos.toDebugIdList() << ")    Next(" << m_NextPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
+        str << "node OR" << "    First(" << m_FirstPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
         for (auto child : m_Children)
         {
             child->trace(str, indent + 1);
@@ -310,14 +475,14 @@ namespace RegularExpression
     {
     }
 
-    bool OptionNode::nullable()
+    OptionNode::~OptionNode()
     {
-        return true;
+        releaseTree();
     }
 
-    std::shared_ptr<BaseLexerTreeNode> OptionNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> OptionNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const
     {
-        return std::make_shared<OptionNode>(m_pChild->clone());
+        return makeShared<OptionNode>(std::move(children[0]));
     }
 
     std::string OptionNode::toDebugString() const
@@ -334,22 +499,23 @@ namespace RegularExpression
         return -1;
     }
 
-    void OptionNode::computeNextPos()
+    void OptionNode::getChildren(std::vector<BaseLexerTreeNode*>& children) const
     {
-        m_pChild->computeNextPos();
-        addNext(m_pChild->getNextPos());
+        children.push_back(m_pChild.get());
     }
 
-    void OptionNode::computeFirstPos()
+    void OptionNode::moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children)
     {
-        m_pChild->computeFirstPos();
-        addFirst(m_pChild->getFirstPos());
+        if (m_pChild)
+            children.push_back(std::move(m_pChild));
     }
 
-    void OptionNode::computeLastPos()
+    void OptionNode::computePositions(FollowPositions& /*follows*/)
     {
-        m_pChild->computeLastPos();
+        addFirst(m_pChild->getFirstPos());
         addLast(m_pChild->getLastPos());
+        m_nullable = true;
+        m_pChild->releasePositions();
     }
 
 #ifdef TRACE_EXPREG
@@ -357,7 +523,7 @@ namespace RegularExpression
     {
         for (int i = 0; i < indent; i++)
             str << "    ";
-        str << "node OPTION" << "    First(" << m_FirstPos.toDebugIdList() << ")    Next(" << m_NextPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
+        str << "node OPTION" << "    First(" << m_FirstPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
         m_pChild->trace(str, indent + 1);
     }
 #endif
@@ -370,14 +536,14 @@ namespace RegularExpression
     {
     }
 
-    bool PlusNode::nullable()
+    PlusNode::~PlusNode()
     {
-        return m_pChild->nullable();
+        releaseTree();
     }
 
-    std::shared_ptr<BaseLexerTreeNode> PlusNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> PlusNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const
     {
-        return std::make_shared<PlusNode>(m_pChild->clone());
+        return makeShared<PlusNode>(std::move(children[0]));
     }
 
     std::string PlusNode::toDebugString() const
@@ -394,25 +560,24 @@ namespace RegularExpression
         return -1;
     }
 
-    void PlusNode::computeNextPos()
+    void PlusNode::getChildren(std::vector<BaseLexerTreeNode*>& children) const
     {
-        for (auto last : m_LastPos)
-        {
-            last->addNext(m_FirstPos);
-        }
-        m_pChild->computeNextPos();
+        children.push_back(m_pChild.get());
     }
 
-    void PlusNode::computeFirstPos()
+    void PlusNode::moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children)
     {
-        m_pChild->computeFirstPos();
-        addFirst(m_pChild->getFirstPos());
+        if (m_pChild)
+            children.push_back(std::move(m_pChild));
     }
 
-    void PlusNode::computeLastPos()
+    void PlusNode::computePositions(FollowPositions& follows)
     {
-        m_pChild->computeLastPos();
+        addFirst(m_pChild->getFirstPos());
         addLast(m_pChild->getLastPos());
+        m_nullable = m_pChild->nullable();
+        m_pChild->releasePositions();
+        follows.add(m_LastPos, m_FirstPos);
     }
 
 #ifdef TRACE_EXPREG
@@ -420,11 +585,95 @@ namespace RegularExpression
     {
         for (int i = 0; i < indent; i++)
             str << "    ";
-        str << "node PLUS" << "    First(" << m_FirstPos.toDebugIdList() << ")    Next(" << m_NextPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
+        str << "node PLUS" << "    First(" << m_FirstPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
         m_pChild->trace(str, indent + 1);
     }
 #endif
 
+    ///////////////////////////////////////////////////////////////
+    //	class MacroNode
+
+    MacroNode::MacroNode(std::shared_ptr<BaseLexerTreeNode>	macro)
+        :MacroNode(macro, macro->getPositionCount())
+    {
+    }
+
+    MacroNode::MacroNode(std::shared_ptr<BaseLexerTreeNode>	macro, int positionCount)
+        :m_pMacro(macro), m_positionCount(positionCount)
+    {
+        m_firstId = CharValueNode::reserveIds(positionCount);
+    }
+
+    BaseLexerTreeNode& MacroNode::getInstance()
+    {
+        if (!m_pInstance)
+        {
+            ReservedIdsScope scope(m_firstId, m_positionCount);
+            m_pInstance = m_pMacro->clone();
+        }
+        return *m_pInstance;
+    }
+
+    MacroNode::~MacroNode()
+    {
+        releaseTree();
+    }
+
+    std::shared_ptr<BaseLexerTreeNode> MacroNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& /*children*/) const
+    {
+        // the copy refers to the same macro
+        return makeShared<MacroNode>(m_pMacro, m_positionCount);
+    }
+
+    std::string MacroNode::toDebugString() const
+    {
+        return m_pMacro->toDebugString();
+    }
+
+    int MacroNode::getAcceptLexId() const
+    {
+        // cannot contain end node
+        return -1;
+    }
+
+    int MacroNode::getNodePositionCount() const
+    {
+        return m_positionCount;
+    }
+
+    void MacroNode::getChildren(std::vector<BaseLexerTreeNode*>& /*children*/) const
+    {
+        // the copy of the macro is not a child: the macro is shared by the copies of the reference
+    }
+
+    void MacroNode::moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children)
+    {
+        if (m_pMacro)
+            children.push_back(std::move(m_pMacro));
+        if (m_pInstance)
+            children.push_back(std::move(m_pInstance));
+    }
+
+    void MacroNode::computePositions(FollowPositions& follows)
+    {
+        auto& instance = getInstance();
+        instance.computeTreePositions(follows);
+        addFirst(instance.getFirstPos());
+        addLast(instance.getLastPos());
+        m_nullable = instance.nullable();
+        instance.releasePositions();
+    }
+
+#ifdef TRACE_EXPREG
+    void MacroNode::trace(std::ostream&     str, int indent)
+    {
+        for (int i = 0; i < indent; i++)
+            str << "    ";
+        str << "node MACRO" << "    First(" << m_FirstPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
+        getInstance().trace(str, indent + 1);
+    }
+#endif
+
     ///////////////////////////////////////////////////////////////
     //	class LeafNode
 
@@ -433,35 +682,34 @@ namespace RegularExpression
     {
     }
 
-    void StarNode::computeNextPos()
+    void StarNode::getChildren(std::vector<BaseLexerTreeNode*>& children) const
     {
-        for (auto last : m_LastPos)
-        {
-            last->addNext(m_FirstPos);
-        }
-        m_pChild->computeNextPos();
+        children.push_back(m_pChild.get());
     }
 
-    void StarNode::computeFirstPos()
+    void StarNode::moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children)
     {
-        m_pChild->computeFirstPos();
-        addFirst(m_pChild->getFirstPos());
+        if (m_pChild)
+            children.push_back(std::move(m_pChild));
     }
 
-    void StarNode::computeLastPos()
+    void StarNode::computePositions(FollowPositions& follows)
     {
-        m_pChild->computeLastPos();
+        addFirst(m_pChild->getFirstPos());
         addLast(m_pChild->getLastPos());
+        m_nullable = true;
+        m_pChild->releasePositions();
+        follows.add(m_LastPos, m_FirstPos);
     }
 
-    bool StarNode::nullable()
+    StarNode::~StarNode()
     {
-        return true;
+        releaseTree();
     }
 
-    std::shared_ptr<BaseLexerTreeNode> StarNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> StarNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const
     {
-        return std::make_shared<StarNode>(m_pChild);
+        return makeShared<StarNode>(std::move(children[0]));
     }
 
     std::string StarNode::toDebugString() const
@@ -483,7 +731,7 @@ namespace RegularExpression
     {
         for (int i = 0; i < indent; i++)
             str << "    ";
-        str << "node STAR" << "    First(" << m_FirstPos.toDebugIdList() << ")    Next(" << m_NextPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
+        str << "node STAR" << "    First(" << m_FirstPos.toDebugIdList() << ")    Last(" << m_LastPos.toDebugIdList() << ")" << std::endl;
         m_pChild->trace(str, indent + 1);
     }
 #endif
@@ -493,7 +741,7 @@ namespace RegularExpression
 
     LeafNode::LeafNode(CHARSET_TYPE val)
     {
-        auto v = std::make_shared<MultiInterval>();
+        auto v = makeShared<MultiInterval>();
 		v->addInterval(Interval(val, val));
         m_Val = v;
     }
@@ -503,15 +751,10 @@ namespace RegularExpression
 		m_Val = i;
 	}
 
-    bool LeafNode::nullable()
-    {
-        return false;
-    }
-
-    std::shared_ptr<BaseLexerTreeNode> LeafNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> LeafNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& /*children*/) const
     {
 		std::shared_ptr<Set> val = std::dynamic_pointer_cast<Set>(m_Val->clone());
-        return std::make_shared<LeafNode>(val);
+        return makeShared<LeafNode>(val);
     }
 
     bool LeafNode::operator==(const CharValueNode & node) const
@@ -534,21 +777,6 @@ namespace RegularExpression
         return m_Val->toDebugString();
     }
 
-    void LeafNode::computeNextPos()
-    {
-        // nothing to do
-    }
-
-    void LeafNode::computeFirstPos()
-    {
-        addFirst(this);
-    }
-
-    void LeafNode::computeLastPos()
-    {
-        addLast(this);
-    }
-
     std::shared_ptr<Set> LeafNode::getValuesSet()
     {
         return m_Val;
@@ -560,7 +788,7 @@ namespace RegularExpression
         for (int i = 0; i < indent; i++)
             str << "    ";
         str << "#" << getId() << " value ";
-        str << m_Val->toDebugString() << "    Next(" << m_NextPos.toDebugIdList() << ")";
+        str << m_Val->toDebugString();
         str << std::endl;
     }
 #endif
@@ -569,7 +797,7 @@ namespace RegularExpression
     //	class RangeNode
     RangeNode::RangeNode()
     {
-        m_Val = std::make_shared<MultiInterval>();
+        m_Val = makeShared<MultiInterval>();
     }
 
     void RangeNode::addInterval(const Interval& i)
@@ -577,34 +805,14 @@ namespace RegularExpression
         m_Val->addInterval(i);
     }
 
-    void RangeNode::computeNextPos()
-    {
-        // nothing to do
-    }
-
-    void RangeNode::computeFirstPos()
-    {
-        addFirst(this);
-    }
-
-    void RangeNode::computeLastPos()
-    {
-        addLast(this);
-    }
-
     std::shared_ptr<Set> RangeNode::getValuesSet()
     {
         return m_Val;
     }
 
-    bool RangeNode::nullable()
-    {
-        return false;
-    }
-
-    std::shared_ptr<BaseLexerTreeNode> RangeNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> RangeNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& /*children*/) const
     {
-        auto p = std::make_shared<RangeNode>();
+        auto p = makeShared<RangeNode>();
         for (const auto& inter : m_Val->getIntervals())
         {
             p->addInterval(inter);
@@ -638,7 +846,7 @@ namespace RegularExpression
         for (int i = 0; i < indent; i++)
             str << "    ";
         str << "#" << getId() << " value ";
-        str << m_Val->toDebugString() << "    Next(" << m_NextPos.toDebugIdList() << ")";
+        str << m_Val->toDebugString();
         str << std::endl;
     }
 #endif
@@ -649,7 +857,7 @@ namespace RegularExpression
 
     ExceptNode::ExceptNode()
     {
-        m_Val = std::make_shared<MultiAntiInterval>();
+        m_Val = makeShared<MultiAntiInterval>();
     }
 
     void ExceptNode::addException(const Interval&	exception)
@@ -657,34 +865,14 @@ namespace RegularExpression
         m_Val->addInterval(exception);
     }
 
-    void ExceptNode::computeNextPos()
-    {
-        // nothing to do
-    }
-
-    void ExceptNode::computeFirstPos()
-    {
-        addFirst(this);
-    }
-
-    void ExceptNode::computeLastPos()
-    {
-        addLast(this);
-    }
-
     std::shared_ptr<Set> ExceptNode::getValuesSet()
     {
         return m_Val;
     }
 
-    bool ExceptNode::nullable()
+    std::shared_ptr<BaseLexerTreeNode> ExceptNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& /*children*/) const
     {
-        return false;
-    }
-
-    std::shared_ptr<BaseLexerTreeNode> ExceptNode::clone() const
-    {
-        auto node = std::make_shared<ExceptNode>();
+        auto node = makeShared<ExceptNode>();
         for (const auto& val : m_Val->getIntervals())
         {
             node->addException(val);
@@ -718,7 +906,7 @@ namespace RegularExpression
         for (int i = 0; i < indent; i++)
             str << "    ";
         str << "#" << getId() << " value ";
-        str << m_Val->toDebugString() << "    Next(" << m_NextPos.toDebugIdList() << ")";
+        str << m_Val->toDebugString();
         str << std::endl;
     }
 #endif
@@ -726,19 +914,14 @@ namespace RegularExpression
     ///////////////////////////////////////////////////////////////
     //	class EndNode
 
-    EndNode::EndNode(short idLexAccepted)
+    EndNode::EndNode(int idLexAccepted)
     {
         m_idLexAccepted = idLexAccepted;
     }
 
-    bool EndNode::nullable()
-    {
-        return false;
-    }
-
-    std::shared_ptr<BaseLexerTreeNode> EndNode::clone() const
+    std::shared_ptr<BaseLexerTreeNode> EndNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& /*children*/) const
     {
-        return std::make_shared<EndNode>(m_idLexAccepted);
+        return makeShared<EndNode>(m_idLexAccepted);
     }
 
     bool EndNode::operator==(const CharValueNode & node) const
@@ -769,21 +952,6 @@ namespace RegularExpression
         return m_idLexAccepted;
     }
 
-    void EndNode::computeNextPos()
-    {
-        // nothing to do
-    }
-
-    void EndNode::computeFirstPos()
-    {
-        addFirst(this);
-    }
-
-    void EndNode::computeLastPos()
-    {
-        addLast(this);
-    }
-
     std::shared_ptr<Set> EndNode::getValuesSet()
     {
         return EmptySet::get();
@@ -801,14 +969,9 @@ namespace RegularExpression
     ///////////////////////////////////////////////////////////////
     //	class EmptyNode
 
-    bool EmptyNode::nullable()
+    std::shared_ptr<BaseLexerTreeNode> EmptyNode::cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& /*children*/) const
     {
-        return true;
-    }
-
-    std::shared_ptr<BaseLexerTreeNode> EmptyNode::clone() const
-    {
-        return std::make_shared<EmptyNode>();
+        return makeShared<EmptyNode>();
     }
 
     bool EmptyNode::operator==(const CharValueNode & node) const
@@ -836,17 +999,10 @@ namespace RegularExpression
     }
 #endif
 
-    void EmptyNode::computeNextPos()
-    {
-        // nothing to do
-    }
-
-    void EmptyNode::computeFirstPos()
-    {
-    }
-
-    void EmptyNode::computeLastPos()
+    void EmptyNode::computePositions(FollowPositions& /*follows*/)
     {
+        // not a position
+        m_nullable = true;
     }
 
     std::shared_ptr<Set> EmptyNode::getValuesSet()
@@ -857,154 +1013,153 @@ namespace RegularExpression
     ///////////////////////////////////////////////////////////////
     //	classes Set
 
-	std::shared_ptr<MultiInterval> Set::wordSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::aphabeticSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::alphanumericSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::lowerSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::upperSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::digitSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::hexaDigitSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::spaceSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::blankSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::controlSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::printSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::graphSet = nullptr;
-	std::shared_ptr<MultiInterval> Set::punctSet = nullptr;
-
+	// the predefined sets are function-local statics: their initialization is thread safe
 	std::shared_ptr<MultiInterval> Set::getWordSet()
 	{
-		if (!wordSet)
+		static const auto wordSet = []()
 		{
-			wordSet = std::make_shared<MultiInterval>();
-			wordSet->addInterval(Interval('0', '9'));
-			wordSet->addInterval(Interval('a', 'z'));
-			wordSet->addInterval(Interval('A', 'Z'));
-			wordSet->addInterval(Interval('_', '_'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('0', '9'));
+			set->addInterval(Interval('a', 'z'));
+			set->addInterval(Interval('A', 'Z'));
+			set->addInterval(Interval('_', '_'));
+			return set;
+		}();
 		return wordSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getAlphabeticSet()
 	{
-		if (!aphabeticSet)
+		static const auto aphabeticSet = []()
 		{
-			aphabeticSet = std::make_shared<MultiInterval>();
-			aphabeticSet->addInterval(Interval('a', 'z'));
-			aphabeticSet->addInterval(Interval('A', 'Z'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('a', 'z'));
+			set->addInterval(Interval('A', 'Z'));
+			return set;
+		}();
 		return aphabeticSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getAlphanumericSet()
 	{
-		if (!alphanumericSet)
+		static const auto alphanumericSet = []()
 		{
-			alphanumericSet = std::make_shared<MultiInterval>();
-			alphanumericSet->addInterval(Interval('0','9'));
-			alphanumericSet->addInterval(Interval('a', 'z'));
-			alphanumericSet->addInterval(Interval('A', 'Z'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('0','9'));
+			set->addInterval(Interval('a', 'z'));
+			set->addInterval(Interval('A', 'Z'));
+			return set;
+		}();
 		return alphanumericSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getLowerSet()
 	{
-		if (!lowerSet)
+		static const auto lowerSet = []()
 		{
-			lowerSet = std::make_shared<MultiInterval>();
-			lowerSet->addInterval(Interval('a', 'z'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('a', 'z'));
+			return set;
+		}();
 		return lowerSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getUpperSet()
 	{
-		if (!upperSet)
+		static const auto upperSet = []()
 		{
-			upperSet = std::make_shared<MultiInterval>();
-			upperSet->addInterval(Interval('A', 'Z'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('A', 'Z'));
+			return set;
+		}();
 		return upperSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getDigitSet()
 	{
-		if (!digitSet)
+		static const auto digitSet = []()
 		{
-			digitSet = std::make_shared<MultiInterval>();
-			digitSet->addInterval(Interval('0', '9'));
-
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('0', '9'));
+			return set;
+		}();
 		return digitSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getHexaDigitSet()
 	{
-		if (!hexaDigitSet)
+		static const auto hexaDigitSet = []()
 		{
-			hexaDigitSet = std::make_shared<MultiInterval>();
-			hexaDigitSet->addInterval(Interval('0', '9'));
-			hexaDigitSet->addInterval(Interval('a', 'f'));
-			hexaDigitSet->addInterval(Interval('A', 'F'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval('0', '9'));
+			set->addInterval(Interval('a', 'f'));
+			set->addInterval(Interval('A', 'F'));
+			return set;
+		}();
 		return hexaDigitSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getSpaceSet()
 	{
-		if (!spaceSet)
+		static const auto spaceSet = []()
 		{
-			spaceSet = std::make_shared<MultiInterval>();
-			spaceSet->addInterval(Interval(' ', ' '));
-			spaceSet->addInterval(Interval('\t', '\t'));
-			spaceSet->addInterval(Interval('\n', '\n'));
-			spaceSet->addInterval(Interval('\v', '\v'));
-			spaceSet->addInterval(Interval('\f', '\f'));
-			spaceSet->addInterval(Interval('\r', '\r'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval(' ', ' '));
+			set->addInterval(Interval('\t', '\t'));
+			set->addInterval(Interval('\n', '\n'));
+			set->addInterval(Interval('\v', '\v'));
+			set->addInterval(Interval('\f', '\f'));
+			set->addInterval(Interval('\r', '\r'));
+			return set;
+		}();
 		return spaceSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getBlankSet()
 	{
-		if (!blankSet)
+		static const auto blankSet = []()
 		{
-			blankSet = std::make_shared<MultiInterval>();
-			blankSet->addInterval(Interval(' ', ' '));
-			blankSet->addInterval(Interval('\t', '\t'));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval(' ', ' '));
+			set->addInterval(Interval('\t', '\t'));
+			return set;
+		}();
 		return blankSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getControlSet()
 	{
-		if (!controlSet)
+		static const auto controlSet = []()
 		{
-			controlSet = std::make_shared<MultiInterval>();
-			controlSet->addInterval(Interval(0, 31));
-			controlSet->addInterval(Interval(127, 127));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval(0, 31));
+			set->addInterval(Interval(127, 127));
+			return set;
+		}();
 		return controlSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getPrintSet()
 	{
-		if (!printSet)
+		static const auto printSet = []()
 		{
-			printSet = std::make_shared<MultiInterval>();
-			printSet->addInterval(Interval(32, 126));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval(32, 126));
+			return set;
+		}();
 		return printSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getGraphSet()
 	{
-		if (!graphSet)
+		static const auto graphSet = []()
 		{
-			graphSet = std::make_shared<MultiInterval>();
-			graphSet->addInterval(Interval(33, 126));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval(33, 126));
+			return set;
+		}();
 		return graphSet;
 	}
 	std::shared_ptr<MultiInterval> Set::getPunctSet()
 	{
-		if (!punctSet)
+		static const auto punctSet = []()
 		{
-			punctSet = std::make_shared<MultiInterval>();
-			punctSet->addInterval(Interval(33, 47));
-			punctSet->addInterval(Interval(58, 64));
-			punctSet->addInterval(Interval(91, 96));
-			punctSet->addInterval(Interval(123, 126));
-		}
+			auto set = std::make_shared<MultiInterval>();
+			set->addInterval(Interval(33, 47));
+			set->addInterval(Interval(58, 64));
+			set->addInterval(Interval(91, 96));
+			set->addInterval(Interval(123, 126));
+			return set;
+		}();
 		return punctSet;
 	}
 
@@ -1017,17 +1172,16 @@ namespace RegularExpression
         if (multi && multi->getIntervals().size() == 1)
         {
             const auto& i = *multi->getIntervals().begin();
-            return std::make_shared<Interval>(i.getMin(), i.getMax());
+            return makeShared<Interval>(i.getMin(), i.getMax());
         }
         return nullptr;
     }
 
-    std::shared_ptr<EmptySet> EmptySet::emptySet=nullptr;
+    // created at startup rather than on first use: the contexts of a lexer are computed by concurrent threads
+    std::shared_ptr<EmptySet> EmptySet::emptySet(new EmptySet());
 
     std::shared_ptr<EmptySet> EmptySet::get()
     {
-        if (emptySet == nullptr)
-            emptySet = std::shared_ptr<EmptySet>(new EmptySet());
         return emptySet;
     }
 
@@ -1074,12 +1228,11 @@ namespace RegularExpression
         return "()";
     }
 
-    std::shared_ptr<WholeSet> WholeSet::wholeSet = nullptr;
+    // created at startup rather than on first use: the contexts of a lexer are computed by concurrent threads
+    std::shared_ptr<WholeSet> WholeSet::wholeSet(new WholeSet());
 
     std::shared_ptr<WholeSet> WholeSet::get()
     {
-        if (wholeSet == nullptr)
-            wholeSet = std::shared_ptr<WholeSet>(new WholeSet());
         return wholeSet;
     }
 
@@ -1135,11 +1288,11 @@ namespace RegularExpression
     std::shared_ptr<Interval> Interval::intersectWith(const Interval &i) const
     {
         if (m_min <= i.getMax() && m_min >= i.getMin())
-            return std::make_shared<Interval>(m_min, m_max > i.getMax() ? i.getMax() : m_max);
+            return makeShared<Interval>(m_min, m_max > i.getMax() ? i.getMax() : m_max);
         else if (m_max <= i.getMax() && m_max >= i.getMin())
-            return std::make_shared<Interval>(m_min < i.getMin() ? i.getMin() : m_min, m_max);
+            return makeShared<Interval>(m_min < i.getMin() ? i.getMin() : m_min, m_max);
         else if (m_min <= i.getMin() && m_max >= i.getMax())
-            return std::make_shared<Interval>(i);
+            return makeShared<Interval>(i);
         return nullptr;
     }
 
@@ -1148,22 +1301,22 @@ namespace RegularExpression
         auto intersect = intersectWith(i);
         if (intersect)
         {
-            return std::make_shared<Interval>(m_min<i.getMin() ? m_min : i.getMin(), m_max>i.getMax() ? m_max : i.getMax());
+            return makeShared<Interval>(m_min<i.getMin() ? m_min : i.getMin(), m_max>i.getMax() ? m_max : i.getMax());
         }
         else if ((m_max + 1) == i.m_min)
         {
-            return std::make_shared<Interval>(m_min, i.m_max);
+            return makeShared<Interval>(m_min, i.m_max);
         }
         else if ((i.m_max + 1) == m_min)
         {
-            return std::make_shared<Interval>(i.m_min, m_max);
+            return makeShared<Interval>(i.m_min, m_max);
         }
         else
         {
             std::set<Interval>  set;
             set.insert(Interval(m_min, m_max));
             set.insert(Interval(i.m_min, i.m_max));
-            return std::make_shared<MultiInterval>(std::move(set));
+            return makeShared<MultiInterval>(std::move(set));
         }
     }
 
@@ -1171,7 +1324,7 @@ namespace RegularExpression
     {
         if (getMin() > i.getMax() || getMax() < i.getMin()) // disjoined sets
         {
-            return std::make_shared<Interval>(*this);
+            return makeShared<Interval>(*this);
         }
 
         if (getMin() < i.getMin())
@@ -1181,16 +1334,16 @@ namespace RegularExpression
                 std::set<Interval>  set;
                 set.insert(Interval(getMin(), i.getMin() - 1));
                 set.insert(Interval(i.getMax() + 1, getMax()));
-                return std::make_shared<MultiInterval>(std::move(set));
+                return makeShared<MultiInterval>(std::move(set));
             }
             else if (getMax() >= i.getMin())
             {
-                return std::make_shared<Interval>(getMin(), i.getMin() - 1);
+                return makeShared<Interval>(getMin(), i.getMin() - 1);
             }
         }
         else if (getMax() > i.getMax())
         {
-            return std::make_shared<Interval>(i.getMax()+1, getMax());
+            return makeShared<Interval>(i.getMax()+1, getMax());
         }
         return EmptySet::get(); // remains nothing
     }
@@ -1249,10 +1402,10 @@ namespace RegularExpression
         auto *multi = dynamic_cast<const MultiInterval*>(i.get());
         if (multi)
         {
-            std::shared_ptr<Set> res = std::make_shared<Interval>(*this);
+            std::shared_ptr<Set> res = makeShared<Interval>(*this);
             for (const auto& interval : multi->getIntervals())
             {
-                res = res->substract(std::make_shared<Interval>(interval));
+                res = res->substract(makeShared<Interval>(interval));
             }
             return res;
         }
@@ -1276,7 +1429,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> Interval::reverse() const
     {
-        auto anti = std::make_shared<MultiAntiInterval>();
+        auto anti = makeShared<MultiAntiInterval>();
         anti->addInterval(*this);
         return anti;
     }
@@ -1298,7 +1451,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> Interval::clone() const
     {
-        return std::make_shared<Interval>(m_min, m_max);
+        return makeShared<Interval>(m_min, m_max);
     }
 
     std::string Interval::toCpp(const std::string & varName, bool inverse) const
@@ -1377,7 +1530,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiInterval::intersectWith(const Interval &i) const
     {
-        auto multi = std::make_shared<MultiInterval>();
+        auto multi = makeShared<MultiInterval>();
         for (const auto& interval : m_intervals)
         {
             auto intersect = interval.intersectWith(i);
@@ -1395,7 +1548,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiInterval::unionWith(const Interval &i) const
     {
-        auto multi = std::make_shared<MultiInterval>(*this);
+        auto multi = makeShared<MultiInterval>(*this);
         multi->addInterval(i);
         auto interval = convertToInterval(multi);
         if (interval)
@@ -1410,7 +1563,7 @@ namespace RegularExpression
         else if (i == WholeSet::get())
             return clone();
 
-        auto res = std::make_shared<MultiInterval>();
+        auto res = makeShared<MultiInterval>();
         if (auto *interval = dynamic_cast<const Interval*>(i.get()))
         {
             for (const auto& part : m_intervals)
@@ -1436,12 +1589,16 @@ namespace RegularExpression
         {
             for (const auto& inter : m_intervals)
             {
-                std::shared_ptr<Set> rest = std::make_shared<Interval>(inter);
+                std::shared_ptr<Set> rest = makeShared<Interval>(inter);
                 for (const auto& anti : multiAnti->getIntervals())
                 {
-                    rest = rest->substract(std::make_shared<Interval>(anti));
+                    rest = rest->substract(makeShared<Interval>(anti));
                 }
-                res = std::static_pointer_cast<MultiInterval>(res->unionWith(rest));
+                // the union may be of any kind of set, so add the parts of the rest to the result
+                if (auto *restInterval = dynamic_cast<const Interval*>(rest.get()))
+                    res->addInterval(*restInterval);
+                else if (auto *restMulti = dynamic_cast<const MultiInterval*>(rest.get()))
+                    res->addInterval(restMulti->getIntervals());
             }
         }
 
@@ -1460,7 +1617,7 @@ namespace RegularExpression
             return unionWith(*interval);
         else if (auto *multi = dynamic_cast<const MultiInterval*>(i.get()))
         {
-            auto res = std::make_shared<MultiInterval>(*this);
+            auto res = makeShared<MultiInterval>(*this);
             for (const auto& part : multi->m_intervals)
                 res->addInterval(part);
             auto set = convertToInterval(res);
@@ -1474,7 +1631,7 @@ namespace RegularExpression
             std::shared_ptr<Set> res = EmptySet::get();
             for (const auto& antiInterval : multiAnti->getIntervals())
             {
-                auto temp = antiInterval.substract(std::make_shared<MultiInterval>(*this));
+                auto temp = antiInterval.substract(makeShared<MultiInterval>(*this));
                 res = res->unionWith(temp);
             }
             return res->reverse();
@@ -1533,7 +1690,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiInterval::reverse() const
     {
-        auto anti = std::make_shared<MultiAntiInterval>();
+        auto anti = makeShared<MultiAntiInterval>();
         for (const auto& interval : getIntervals())
         {
             anti->addInterval(interval);
@@ -1569,7 +1726,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiInterval::clone() const
     {
-        return std::make_shared<MultiInterval>(*this);
+        return makeShared<MultiInterval>(*this);
     }
 
     std::string MultiInterval::toCpp(const std::string & varName, bool inverse) const
@@ -1641,10 +1798,10 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiAntiInterval::intersectWith(const Interval &i) const
     {
-        std::shared_ptr<Set> res = std::make_shared<Interval>(i);
+        std::shared_ptr<Set> res = makeShared<Interval>(i);
         for (const auto& antiInterval : m_intervals)
         {
-            res = res->substract(std::make_shared<Interval>(antiInterval));
+            res = res->substract(makeShared<Interval>(antiInterval));
         }
         return res;
     }
@@ -1657,7 +1814,7 @@ namespace RegularExpression
             auto res = antiInterval.substract(i);
             rest = rest->unionWith(res);
         }
-        auto res = std::make_shared<MultiAntiInterval>();
+        auto res = makeShared<MultiAntiInterval>();
         auto *interval = dynamic_cast<const Interval*>(rest.get());
         if (interval)
         {
@@ -1684,19 +1841,19 @@ namespace RegularExpression
         }
         else if (auto *multi = dynamic_cast<const MultiInterval*>(i.get()))
         {
-            std::shared_ptr<Set> res = std::make_shared<MultiAntiInterval>(*this);
+            std::shared_ptr<Set> res = makeShared<MultiAntiInterval>(*this);
             for (const auto& interval : multi->getIntervals())
             {
-                res = res->intersectWith(std::make_shared<Interval>(interval));
+                res = res->intersectWith(makeShared<Interval>(interval));
             }
             return res;
         }
         else if (auto *antiMulti = dynamic_cast<const MultiAntiInterval*>(i.get()))
         {
-            std::shared_ptr<Set> res = std::make_shared<MultiAntiInterval>(*this);
+            std::shared_ptr<Set> res = makeShared<MultiAntiInterval>(*this);
             for (const auto& interval : antiMulti->getIntervals())
             {
-                res = res->unionWith(std::make_shared<Interval>(interval));
+                res = res->unionWith(makeShared<Interval>(interval));
             }
             return res;
         }
@@ -1714,19 +1871,19 @@ namespace RegularExpression
         }
         else if (auto *multi = dynamic_cast<const MultiInterval*>(i.get()))
         {
-            std::shared_ptr<Set> res = std::make_shared<MultiAntiInterval>(*this);
+            std::shared_ptr<Set> res = makeShared<MultiAntiInterval>(*this);
             for (const auto& interval : multi->getIntervals())
             {
-                res = res->unionWith(std::make_shared<Interval>(interval));
+                res = res->unionWith(makeShared<Interval>(interval));
             }
             return res;
         }
         else if (auto *antiMulti = dynamic_cast<const MultiAntiInterval*>(i.get()))
         {
-            std::shared_ptr<Set> res = std::make_shared<MultiAntiInterval>(*this);
+            std::shared_ptr<Set> res = makeShared<MultiAntiInterval>(*this);
             for (const auto& interval : antiMulti->getIntervals())
             {
-                res = res->intersectWith(std::make_shared<Interval>(interval));
+                res = res->intersectWith(makeShared<Interval>(interval));
             }
             return res;
         }
@@ -1743,7 +1900,7 @@ namespace RegularExpression
             std::shared_ptr<Set> res = i;
             for (const auto& inter : getIntervals())
             {
-                res = res->unionWith(std::make_shared<Interval>(inter));
+                res = res->unionWith(makeShared<Interval>(inter));
             }
             return res->reverse();
         }
@@ -1752,7 +1909,7 @@ namespace RegularExpression
             std::shared_ptr<Set> res = i;
             for (const auto& inter : getIntervals())
             {
-                res = res->unionWith(std::make_shared<Interval>(inter));
+                res = res->unionWith(makeShared<Interval>(inter));
             }
             return res->reverse();
         }
@@ -1768,7 +1925,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiAntiInterval::reverse() const
     {
-        auto multi = std::make_shared<MultiInterval>();
+        auto multi = makeShared<MultiInterval>();
         for (const auto& interval : getIntervals())
         {
             multi->addInterval(interval);
@@ -1799,7 +1956,7 @@ namespace RegularExpression
 
     std::shared_ptr<Set> MultiAntiInterval::clone() const
     {
-        return std::make_shared<MultiAntiInterval>(*this);
+        return makeShared<MultiAntiInterval>(*this);
     }
 
     std::string MultiAntiInterval::toCpp(const std::string & varName, bool inverse) const
@@ -1935,7 +2092,7 @@ namespace RegularExpression
         }
     };
 
-    std::vector<std::pair<PositionSet, PositionSet>> PositionSet::BreakByPositionSet()
+    std::vector<std::pair<PositionSet, PositionSet>> PositionSet::BreakByPositionSet() const
     {
         PositionSetBreaker  breaker(*this);
         return breaker.run();
@@ -2043,8 +2200,36 @@ namespace RegularExpression
 
     CharValueNode::CharValueNode()
     {
-        id = nextId;
-        nextId++;
+        id = reserveIds(1);
+    }
+
+    int CharValueNode::reserveIds(int count)
+    {
+        // inside the copy of a macro, the ids come from the ones reserved by its reference
+        if (reservedIds.next < reservedIds.end)
+        {
+            auto first = reservedIds.next;
+            reservedIds.next += count;
+            assert(reservedIds.next <= reservedIds.end);
+            return first;
+        }
+        return nextId.fetch_add(count);
+    }
+
+    int CharValueNode::getNodePositionCount() const
+    {
+        return 1;
+    }
+
+    void CharValueNode::getChildren(std::vector<BaseLexerTreeNode*>& /*children*/) const
+    {
+        // a leaf
+    }
+
+    void CharValueNode::computePositions(FollowPositions& /*follows*/)
+    {
+        addFirst(this);
+        addLast(this);
     }
 
     int CharValueNode::getAcceptLexId() const
@@ -2056,5 +2241,174 @@ namespace RegularExpression
     {
         return id;
     }
-    int CharValueNode::nextId = 0;
+    std::atomic<int> CharValueNode::nextId{ 0 };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void CodePointSet::addRange(int min, int max)
+    {
+        min = std::max(min, 0);
+        max = std::min(max, maxCodePoint);
+        if (min > max)
+            return;
+        // merges the ranges that overlap or touch [min, max]
+        auto first = std::lower_bound(m_ranges.begin(), m_ranges.end(), min, [](const std::pair<int, int>& r, int v) { return r.second + 1 < v; });
+        auto last = first;
+        while ((last != m_ranges.end()) && (last->first <= max + 1))
+        {
+            min = std::min(min, last->first);
+            max = std::max(max, last->second);
+            ++last;
+        }
+        first = m_ranges.erase(first, last);
+        m_ranges.insert(first, { min, max });
+    }
+
+    void CodePointSet::addSet(const CodePointSet& s)
+    {
+        for (const auto& range : s.m_ranges)
+            addRange(range.first, range.second);
+    }
+
+    CodePointSet CodePointSet::reverse() const
+    {
+        CodePointSet result;
+        int next = 0;
+        for (const auto& range : m_ranges)
+        {
+            if (range.first > next)
+                result.m_ranges.push_back({ next, range.first - 1 });
+            next = range.second + 1;
+        }
+        if (next <= maxCodePoint)
+            result.m_ranges.push_back({ next, maxCodePoint });
+        return result;
+    }
+
+    namespace
+    {
+        // byte intervals of a UTF-8 sequence: each byte of the sequence is in the interval at its index
+        using ByteSequence = std::vector<std::pair<int, int>>;
+
+        int encodeUtf8(int codePoint, int* bytes)
+        {
+            if (codePoint < 0x80)
+            {
+                bytes[0] = codePoint;
+                return 1;
+            }
+            if (codePoint < 0x800)
+            {
+                bytes[0] = 0xC0 | (codePoint >> 6);
+                bytes[1] = 0x80 | (codePoint & 0x3F);
+                return 2;
+            }
+            if (codePoint < 0x10000)
+            {
+                bytes[0] = 0xE0 | (codePoint >> 12);
+                bytes[1] = 0x80 | ((codePoint >> 6) & 0x3F);
+                bytes[2] = 0x80 | (codePoint & 0x3F);
+                return 3;
+            }
+            bytes[0] = 0xF0 | (codePoint >> 18);
+            bytes[1] = 0x80 | ((codePoint >> 12) & 0x3F);
+            bytes[2] = 0x80 | ((codePoint >> 6) & 0x3F);
+            bytes[3] = 0x80 | (codePoint & 0x3F);
+            return 4;
+        }
+
+        // Splits [min, max] until the code points of each part are encoded by the sequences of the byte intervals between
+        // the encodings of its bounds: the parts have the same encoded length, and only their last bytes vary freely.
+        void splitUtf8(int min, int max, std::vector<ByteSequence>& sequences)
+        {
+            for (int lengthMax : { 0x7F, 0x7FF, 0xFFFF })
+            {
+                if ((min <= lengthMax) && (max > lengthMax))
+                {
+                    splitUtf8(min, lengthMax, sequences);
+                    splitUtf8(lengthMax + 1, max, sequences);
+                    return;
+                }
+            }
+            for (int i = 1; i < 4; i++)
+            {
+                int mask = (1 << (6 * i)) - 1;     // the bits of the i last bytes
+                if ((min & ~mask) != (max & ~mask))
+                {
+                    if (min & mask)
+                    {
+                        splitUtf8(min, min | mask, sequences);
+                        splitUtf8((min | mask) + 1, max, sequences);
+                        return;
+                    }
+                    if ((max & mask) != mask)
+                    {
+                        splitUtf8(min, (max & ~mask) - 1, sequences);
+                        splitUtf8(max & ~mask, max, sequences);
+                        return;
+                    }
+                }
+            }
+            int minBytes[4];
+            int maxBytes[4];
+            int length = encodeUtf8(min, minBytes);
+            encodeUtf8(max, maxBytes);
+            ByteSequence sequence;
+            for (int i = 0; i < length; i++)
+                sequence.push_back({ minBytes[i], maxBytes[i] });
+            sequences.push_back(std::move(sequence));
+        }
+
+        std::shared_ptr<BaseLexerTreeNode> byteIntervalNode(const std::pair<int, int>& bytes)
+        {
+            if (bytes.first == bytes.second)
+                return makeShared<LeafNode>((CHARSET_TYPE)bytes.first);
+            auto range = makeShared<RangeNode>();
+            range->addInterval(Interval((CHARSET_TYPE)bytes.first, (CHARSET_TYPE)bytes.second));
+            return range;
+        }
+
+        // Tree of the sorted sequences [begin, end) from their byte 'index': the sequences that begin with the same
+        // intervals share their prefix, so that the positions of the tree are about the states of the automaton.
+        std::shared_ptr<BaseLexerTreeNode> sequencesToTree(std::vector<ByteSequence>::const_iterator begin, std::vector<ByteSequence>::const_iterator end, size_t index)
+        {
+            std::vector<std::shared_ptr<BaseLexerTreeNode>> alternatives;
+            while (begin != end)
+            {
+                auto groupEnd = begin;
+                while ((groupEnd != end) && ((*groupEnd)[index] == (*begin)[index]))
+                    ++groupEnd;
+                auto node = byteIntervalNode((*begin)[index]);
+                if (index + 1 < begin->size())
+                {
+                    std::vector<std::shared_ptr<BaseLexerTreeNode>> concat;
+                    concat.push_back(std::move(node));
+                    concat.push_back(sequencesToTree(begin, groupEnd, index + 1));
+                    node = makeShared<ConcatNode>(std::move(concat));
+                }
+                alternatives.push_back(std::move(node));
+                begin = groupEnd;
+            }
+            if (alternatives.size() == 1)
+                return alternatives.front();
+            return makeShared<OrNode>(std::move(alternatives));
+        }
+    }
+
+    std::shared_ptr<BaseLexerTreeNode> CodePointSet::toUtf8Tree() const
+    {
+        std::vector<ByteSequence> sequences;
+        for (const auto& range : m_ranges)
+        {
+            // the surrogates are not encoded in UTF-8
+            if (range.first < 0xD800)
+                splitUtf8(range.first, std::min(range.second, 0xD7FF), sequences);
+            if (range.second > 0xDFFF)
+                splitUtf8(std::max(range.first, 0xE000), range.second, sequences);
+        }
+        if (sequences.empty())
+            return nullptr;
+        std::sort(sequences.begin(), sequences.end());
+        return sequencesToTree(sequences.begin(), sequences.end(), 0);
+    }
 }
@@ -5,6 +5,11 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <memory_resource>
 
 namespace RegularExpression
 {
@@ -46,6 +51,49 @@ namespace RegularExpression
 
     std::string char2stringExpr(unsigned char v);
 
+    class BaseLexerTreeNode;
+
+    // Memory of the trees of a lexer generator. The nodes created by makeShared() on a thread where an arena is active
+    // (see ArenaScope) are allocated in this arena, and they are all released at once when the arena is destroyed: it
+    // must outlive them. Each thread allocates in its own buffer, so that the contexts computed by concurrent threads
+    // do not contend for the arena.
+    class NodeArena
+    {
+        std::mutex      m_mutex;        // only taken to find the buffer of a thread, when a scope is entered
+        std::map<std::thread::id, std::unique_ptr<std::pmr::monotonic_buffer_resource>>    m_buffers;
+
+    public:
+        // buffer of the calling thread
+        std::pmr::memory_resource* getBuffer();
+
+        // arena active on the current thread, or nullptr
+        static NodeArena* getCurrent();
+        // buffer of the arena active on the current thread, or the heap
+        static std::pmr::memory_resource* getCurrentBuffer();
+    };
+
+    // Makes 'arena' the active arena of the current thread during the life of the scope
+    class ArenaScope
+    {
+        NodeArena*                  m_previous;
+        std::pmr::memory_resource*  m_previousBuffer;
+
+    public:
+        ArenaScope(NodeArena* arena);
+        ~ArenaScope();
+    };
+
+    // The nodes go in the active arena. The other objects, the character sets above all, are mostly temporaries of the
+    // subset construction: they stay on the heap, where their memory is reused once they are released.
+    template <typename T, typename... Args>
+    std::shared_ptr<T> makeShared(Args&&... args)
+    {
+        if constexpr (std::is_base_of_v<BaseLexerTreeNode, T>)
+            return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(NodeArena::getCurrentBuffer()), std::forward<Args>(args)...);
+        else
+            return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+
     class CharValueNode;
     class ExpressionNode;
     class Set;
@@ -57,7 +105,7 @@ namespace RegularExpression
         PositionSet(PositionSet &&s) noexcept :std::set<CharValueNode*>(std::move(s)) {}
         PositionSet(CharValueNode *v) { insert(v); }
 
-        std::vector<std::pair<PositionSet, PositionSet>> BreakByPositionSet();
+        std::vector<std::pair<PositionSet, PositionSet>> BreakByPositionSet() const;
         int getAcceptLexId() const;
         std::string toDebugString() const;
         std::shared_ptr<Set> intersectAll() const;
@@ -75,20 +123,6 @@ namespace RegularExpression
 	class MultiInterval;
     class Set
     {
-		static std::shared_ptr<MultiInterval> wordSet;
-		static std::shared_ptr<MultiInterval> aphabeticSet;
-		static std::shared_ptr<MultiInterval> alphanumericSet;
-		static std::shared_ptr<MultiInterval> lowerSet;
-		static std::shared_ptr<MultiInterval> upperSet;
-		static std::shared_ptr<MultiInterval> digitSet;
-		static std::shared_ptr<MultiInterval> hexaDigitSet;
-		static std::shared_ptr<MultiInterval> spaceSet;
-		static std::shared_ptr<MultiInterval> blankSet;
-		static std::shared_ptr<MultiInterval> controlSet;
-		static std::shared_ptr<MultiInterval> printSet;
-		static std::shared_ptr<MultiInterval> graphSet;
-		static std::shared_ptr<MultiInterval> punctSet;
-
     public:
         virtual std::shared_ptr<Set> intersectWith(std::shared_ptr<Set> i) const = 0;
         virtual std::shared_ptr<Set> unionWith(std::shared_ptr<Set> i) const = 0;
@@ -221,32 +255,74 @@ namespace RegularExpression
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////
 
+    // followpos of the positions of a lexer context, in compressed sparse row form: the positions that may follow the
+    // position of row i are m_follows[m_offsets[i]] to m_follows[m_offsets[i+1]-1], sorted by id.
+    class FollowPositions
+    {
+        std::vector<std::pair<CharValueNode*, CharValueNode*>>  m_edges;    // (position, following position), until build()
+        std::vector<int>                m_offsets;
+        std::vector<CharValueNode*>     m_follows;
+
+    public:
+        // all the positions of 'to' may follow all the positions of 'from'
+        void add(const PositionSet& from, const PositionSet& to);
+        // builds the rows from the added pairs of positions
+        void build();
+
+        // range of the positions that may follow 'position', sorted by id
+        std::pair<CharValueNode* const*, CharValueNode* const*> get(const CharValueNode* position) const;
+    };
+
     class BaseLexerTreeNode
     {
     protected:
         PositionSet	    m_FirstPos;
         PositionSet	    m_LastPos;
-        PositionSet	    m_NextPos;
+        bool            m_nullable = false;
+
+        // Releases the subtrees of the node without recursion, for the destructors of the nodes that have children:
+        // the nodes about to be destroyed first give away their own children, see moveChildren().
+        void releaseTree();
 
     public:
+        virtual ~BaseLexerTreeNode() = default;
+
         inline const PositionSet& getFirstPos() const { return m_FirstPos; }
         inline const PositionSet& getLastPos() const { return m_LastPos; }
-        inline const PositionSet& getNextPos() const { return m_NextPos; }
 
         inline void addFirst(CharValueNode* node) { m_FirstPos.insert(node); }
         inline void addFirst(const PositionSet& nodes) { m_FirstPos.insert(nodes.begin(), nodes.end()); }
         inline void addLast(CharValueNode* node) { m_LastPos.insert(node); }
         inline void addLast(const PositionSet& nodes) { m_LastPos.insert(nodes.begin(), nodes.end()); }
-        inline void addNext(const PositionSet& nodes) { m_NextPos.insert(nodes.begin(), nodes.end()); }
-
-        virtual void computeNextPos() = 0;
-        virtual void computeFirstPos() = 0;
-        virtual void computeLastPos() = 0;
-
-        virtual bool nullable() = 0;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const = 0;
+        // the first and last positions of a node are only needed to compute the ones of its parent
+        inline void releasePositions() { m_FirstPos.clear(); m_LastPos.clear(); }
+        // whether the node matches the empty string, known once its positions are computed
+        inline bool nullable() const { return m_nullable; }
+
+        // The functions below work on the whole tree without recursion: the trees of long literals or of counted
+        // repetitions may be very deep.
+        // nodes of the tree in pre-order: a node is before all the nodes of its subtree
+        void getTreeNodes(std::vector<BaseLexerTreeNode*>& nodes);
+        // Computes the positions of the whole tree in a single sweep over its nodes, children before parents.
+        void computeTreePositions(FollowPositions& follows);
+        std::shared_ptr<BaseLexerTreeNode> clone();
+        // number of positions (character values) of the tree
+        int getPositionCount();
+
+        // children of the node, in order. A reference to a macro has none: the positions of its copy are computed apart
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const = 0;
+        // moves the children owned by the node to 'children'
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& /*children*/) {}
+        // Computes the first and last positions of the node from the ones of its children, which are already computed, 
+        // and adds to 'follows' the followpos found in the node. The positions of the children are released once used.
+        virtual void computePositions(FollowPositions& follows) = 0;
+
+        // copy of the node alone, given the copies of its children
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const = 0;
         virtual std::string toDebugString() const = 0;
         virtual int getAcceptLexId() const = 0;
+        // number of positions of the node itself, without its children
+        virtual int getNodePositionCount() const { return 0; }
 
 #ifdef TRACE_EXPREG
         virtual void trace(std::ostream&     str, int indent) = 0;
@@ -260,15 +336,15 @@ namespace RegularExpression
     public:
         ConcatNode();
         ConcatNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children);
+        ~ConcatNode();
 
         void addChild(std::shared_ptr<BaseLexerTreeNode>	child);
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children) override;
+        virtual void computePositions(FollowPositions& follows) override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual std::string toDebugString() const override;
         virtual int getAcceptLexId() const override;
 
@@ -284,15 +360,15 @@ namespace RegularExpression
     public:
         OrNode();
         OrNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children);
+        ~OrNode();
 
         void addChild(std::shared_ptr<BaseLexerTreeNode>	child);
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children) override;
+        virtual void computePositions(FollowPositions& follows) override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual std::string toDebugString() const override;
         virtual int getAcceptLexId() const override;
 
@@ -307,13 +383,13 @@ namespace RegularExpression
 
     public:
         OptionNode(std::shared_ptr<BaseLexerTreeNode>	child);
+        ~OptionNode();
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children) override;
+        virtual void computePositions(FollowPositions& follows) override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual std::string toDebugString() const override;
         virtual int getAcceptLexId() const override;
 
@@ -328,13 +404,13 @@ namespace RegularExpression
 
     public:
         PlusNode(std::shared_ptr<BaseLexerTreeNode>	child);
+        ~PlusNode();
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children) override;
+        virtual void computePositions(FollowPositions& follows) override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual std::string toDebugString() const override;
         virtual int getAcceptLexId() const override;
 
@@ -349,15 +425,48 @@ namespace RegularExpression
 
     public:
         StarNode(std::shared_ptr<BaseLexerTreeNode>	child);
+        ~StarNode();
+
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children) override;
+        virtual void computePositions(FollowPositions& follows) override;
+
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
+        virtual std::string toDebugString() const override;
+        virtual int getAcceptLexId() const override;
+
+#ifdef TRACE_EXPREG
+        virtual void trace(std::ostream&     str, int indent) override;
+#endif
+    };
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+    // reference to a macro. The tree of the macro is shared by all its references and never modified : it is only
+    // copied, to get distinct positions, when the positions of the reference are computed. The copy cannot be avoided:
+    // a position is a CharValueNode, known by its address in the position sets, the followpos and the states of the
+    // automaton, and every node holds its own first and last positions. References sharing the nodes would share
+    // their positions, and the automaton could not tell the occurences of the macro apart.
+    class MacroNode : public BaseLexerTreeNode
+    {
+        std::shared_ptr<BaseLexerTreeNode>	m_pMacro;
+        std::shared_ptr<BaseLexerTreeNode>	m_pInstance;
+        int		m_positionCount;
+        int		m_firstId;      // ids reserved for the positions of the copy, so that they are numbered as if the macro was copied here
+
+    public:
+        MacroNode(std::shared_ptr<BaseLexerTreeNode>	macro);
+        MacroNode(std::shared_ptr<BaseLexerTreeNode>	macro, int positionCount);
+        ~MacroNode();
+
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void moveChildren(std::vector<std::shared_ptr<BaseLexerTreeNode>>& children) override;
+        virtual void computePositions(FollowPositions& follows) override;
+        // the copy of the macro holding the positions of the reference, made on the first call
+        BaseLexerTreeNode& getInstance();
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual std::string toDebugString() const override;
         virtual int getAcceptLexId() const override;
+        virtual int getNodePositionCount() const override;
 
 #ifdef TRACE_EXPREG
         virtual void trace(std::ostream&     str, int indent) override;
@@ -367,14 +476,22 @@ namespace RegularExpression
     class CharValueNode : public BaseLexerTreeNode
     {
         int id;
-        static int nextId;
+        int followIndex = -1;              // row of the position in the FollowPositions of its context
+        static std::atomic<int> nextId;    // nodes may be created by several lexer generators at the same time
+
+        friend class FollowPositions;
     public:
         CharValueNode();
+        virtual void getChildren(std::vector<BaseLexerTreeNode*>& children) const override;
+        virtual void computePositions(FollowPositions& follows) override;
         virtual std::shared_ptr<Set> getValuesSet() = 0;
         virtual bool operator==(const CharValueNode& node) const = 0;
         virtual std::string toCpp(const std::string& varName, bool inverse) const = 0;
         virtual int getAcceptLexId() const override;
+        virtual int getNodePositionCount() const override;
         int getId() const;
+
+        static int reserveIds(int count);
     };
 
     class LeafNode : public CharValueNode
@@ -386,14 +503,9 @@ namespace RegularExpression
 
         inline std::shared_ptr<Set> getVal() const { return m_Val; }
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
-
         virtual std::shared_ptr<Set> getValuesSet() override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual bool operator==(const CharValueNode& node) const override;
         virtual std::string toCpp(const std::string& varName, bool inverse) const override;
         virtual std::string toDebugString() const override;
@@ -412,14 +524,9 @@ namespace RegularExpression
 
         inline std::shared_ptr<MultiInterval> getVal() const { return m_Val; }
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
-
         virtual std::shared_ptr<Set> getValuesSet() override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual bool operator==(const CharValueNode& node) const override;
         virtual std::string toCpp(const std::string& varName, bool inverse) const override;
         virtual std::string toDebugString() const override;
@@ -440,14 +547,9 @@ namespace RegularExpression
 
         inline std::shared_ptr<MultiAntiInterval> getVal() const { return m_Val; }
 
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
-
         virtual std::shared_ptr<Set> getValuesSet() override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual bool operator==(const CharValueNode& node) const override;
         virtual std::string toCpp(const std::string& varName, bool inverse) const override;
         virtual std::string toDebugString() const override;
@@ -459,21 +561,16 @@ namespace RegularExpression
 
     class EndNode : public CharValueNode
     {
-        short		m_idLexAccepted;
+        int 		m_idLexAccepted;
 
     public:
-        EndNode(short idLexAccepted);
+        EndNode(int idLexAccepted);
 
-        inline short getIdLexAccepted() const { return m_idLexAccepted; }
-
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+        inline int getIdLexAccepted() const { return m_idLexAccepted; }
 
         virtual std::shared_ptr<Set> getValuesSet() override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual bool operator==(const CharValueNode& node) const override;
         virtual std::string toCpp(const std::string& varName, bool inverse) const override;
         virtual std::string toDebugString() const override;
@@ -487,14 +584,11 @@ namespace RegularExpression
     class EmptyNode : public CharValueNode
     {
     public:
-        virtual void computeNextPos() override;
-        virtual void computeFirstPos() override;
-        virtual void computeLastPos() override;
+        virtual void computePositions(FollowPositions& follows) override;
 
         virtual std::shared_ptr<Set> getValuesSet() override;
 
-        virtual bool nullable() override;
-        virtual std::shared_ptr<BaseLexerTreeNode> clone() const override;
+        virtual std::shared_ptr<BaseLexerTreeNode> cloneNode(std::vector<std::shared_ptr<BaseLexerTreeNode>>&& children) const override;
         virtual bool operator==(const CharValueNode& node) const override;
         virtual std::string toCpp(const std::string& varName, bool inverse) const override;
         virtual std::string toDebugString() const override;
@@ -503,4 +597,28 @@ namespace RegularExpression
         virtual void trace(std::ostream&     str, int indent) override;
 #endif
     };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Set of Unicode code points (\u{...}, \p{...}). The lexers read bytes: the set is compiled into the alternative of
+    // the UTF-8 byte sequences of its code points, so that the lexer matches them without decoding the input.
+    class CodePointSet
+    {
+        std::vector<std::pair<int, int>>  m_ranges;     // sorted, disjoint and not adjacent
+
+    public:
+        static constexpr int maxCodePoint = 0x10FFFF;
+
+        inline const std::vector<std::pair<int, int>>& getRanges() const { return m_ranges; }
+        inline bool empty() const { return m_ranges.empty(); }
+        void addRange(int min, int max);
+        void addSet(const CodePointSet& s);
+        CodePointSet reverse() const;
+
+        // tree matching the UTF-8 encoding of the code points (the surrogates excepted), nullptr if there is none
+        std::shared_ptr<BaseLexerTreeNode> toUtf8Tree() const;
+
+        // L, Lu, Ll, N, Nd, P, Zs, XID_Start, XID_Continue (and their long names); nullptr if the property is unknown
+        static const CodePointSet* getProperty(const std::string& name);
+    };
 }
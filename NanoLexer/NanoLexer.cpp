@@ -6,6 +6,9 @@
 #include "LexerBuilder.h"
 #include <filesystem>
 #include <cassert>
+#include <cstdint>
+#include <iomanip>
+#include <algorithm>
 #ifdef WIN32
 #include <windows.h>
 
@@ -28,23 +31,6 @@ std::string getexepath()
 
 namespace
 {
-	std::map<std::string, std::map<std::string, std::shared_ptr<RegularExpression::BaseLexerTreeNode>>> generator2expressions;
-	void addLexerTree(const std::string& generatorName, const std::string& exprName, std::shared_ptr<RegularExpression::BaseLexerTreeNode> tree)
-	{
-		auto iter = generator2expressions.emplace(generatorName, std::map<std::string, std::shared_ptr<RegularExpression::BaseLexerTreeNode>>()).first;
-		iter->second.emplace(exprName, tree);
-	}
-	std::shared_ptr<RegularExpression::BaseLexerTreeNode> getLexerTree(const std::string& generatorName, const std::string& exprName)
-	{
-		auto iter = generator2expressions.find(generatorName);
-		if (iter == generator2expressions.end())
-			return nullptr;
-		auto iterTree = iter->second.find(exprName);
-		if (iterTree == iter->second.end())
-			return nullptr;
-		return iterTree->second;
-	}
-
 	bool checkExpressionAndName(const std::string& name, const std::string& expr, NanoLexer::LexerGenerator& lexgen)
 	{
 		if (expr.empty())
@@ -88,6 +74,66 @@ namespace
 	}
 
 	const char* mainContextName = "main_context";
+
+	// Version of the generated code, part of the hash of the model. It must be changed each time the code generated 
+	// for a same model changes, otherwise LexerGenerator::isUpToDate() would keep outdated files.
+	const char* generatorVersion = "0.4";
+	const char* modelHashVariable = "$(ModelHash)";
+
+	// FNV-1a hash used to identify the model of a lexer in the generated files
+	class ModelHasher
+	{
+		std::uint64_t value = 14695981039346656037ull;
+
+		void addBytes(const std::string& str)
+		{
+			for (unsigned char c : str)
+			{
+				value ^= c;
+				value *= 1099511628211ull;
+			}
+		}
+	public:
+		void add(const std::string& str)
+		{
+			// the length is hashed first so that ("ab","c") and ("a","bc") give different hashes
+			addBytes(std::to_string(str.size()) + ":");
+			addBytes(str);
+		}
+
+		std::string toString() const
+		{
+			std::ostringstream str;
+			str << std::hex << std::setw(16) << std::setfill('0') << value;
+			return str.str();
+		}
+	};
+
+	std::filesystem::path getExeDirectory()
+	{
+		std::filesystem::path exePath = getexepath();
+		exePath.remove_filename();
+		return exePath;
+	}
+
+	// Returns the directory of the skeleton files of 'language', or an empty path when it does not exist.
+	std::filesystem::path getSkeletonDirectory(const std::filesystem::path& exePath, const std::string& language)
+	{
+		auto lexer_sk = exePath / "lexer_sk";
+		if (!std::filesystem::is_directory(lexer_sk))
+		{
+			std::cout << "Bad install, missing directory lexer_sk " << lexer_sk.string() << std::endl;
+			return {};
+		}
+
+		auto skeletonPath = lexer_sk / language;
+		if (!std::filesystem::is_directory(skeletonPath))
+		{
+			std::cout << "Missing directory lexer_sk/" << language << std::endl;
+			return {};
+		}
+		return skeletonPath;
+	}
 }
 
 namespace NanoLexer
@@ -112,25 +158,49 @@ namespace NanoLexer
 		return this;
 	}
 
+	LexerGenerator::Expression* LexerGenerator::Expression::setSkip()
+	{
+		skip = true;
+		return this;
+	}
+
+	LexerGenerator::Expression* LexerGenerator::Expression::setIntegerValue(int base)
+	{
+		if (base < 2 || base > 36)
+		{
+			lexerGenerator.addErrorMessage("Invalid base " + std::to_string(base) + " for the integer value of expression '" + expr + "'");
+			return this;
+		}
+		integerBase = base;
+		return this;
+	}
+
+	LexerGenerator::Expression* LexerGenerator::Expression::setInterned()
+	{
+		interned = true;
+		return this;
+	}
+
 	LexerGenerator::Expression* LexerGenerator::Expression::addOnMatchCode(const std::string& code)
 	{
 		matchCode = code;
 		return this;
 	}
 
-	std::shared_ptr<RegularExpression::BaseLexerTreeNode> parse(const std::string& expr,const std::string& postfixMsg, LexerGenerator& lexerGenerator)
+	std::shared_ptr<RegularExpression::BaseLexerTreeNode> parse(const std::string& expr, const std::string& postfixMsg, const MacroTrees& macros, LexerGenerator& lexerGenerator)
 	{
-		auto tree = parseString(expr.c_str(), postfixMsg);
-		if (getParsingErrorMessages().size())
+		std::vector<std::string> errorMessages;
+		auto tree = parseString(expr.c_str(), postfixMsg, macros, errorMessages);
+		if (errorMessages.size())
 		{
-			lexerGenerator.addErrorMessages(getParsingErrorMessages());
+			lexerGenerator.addErrorMessages(errorMessages);
 		}
 		return tree;
 	}
 
 	// class NanoLexer
 	LexerGenerator::LexerGenerator(const std::string& name, bool throwEarly_)
-		:lexemeCount{ 0 }, currentContext{ mainContextName , {} }, lexerName{ name }, throwEarly{ throwEarly_ }
+		:arena{ std::make_unique<RegularExpression::NodeArena>() }, lexemeCount{ 0 }, currentContext{ mainContextName , {} }, lexerName{ name }, throwEarly{ throwEarly_ }
 	{
 		variables.emplace_back("$(LexerName)", name);
 		lexemeId = 1;
@@ -138,7 +208,6 @@ namespace NanoLexer
 
 	LexerGenerator::~LexerGenerator()
 	{
-		generator2expressions.erase(lexerName);
 	}
 
 	LexerGenerator::Expression* LexerGenerator::addMacro(const std::string& expr, const std::string& name)
@@ -153,8 +222,10 @@ namespace NanoLexer
 		std::string postfixMsg = " in macro '";
 		postfixMsg += name;
 		postfixMsg += "'";
-		auto tree = parse(expr, postfixMsg, *this);
-		addMacroTree(name, tree);
+		// the references to the macro share its tree, see MacroNode
+		RegularExpression::ArenaScope arenaScope(arena.get());
+		auto tree = parse(expr, postfixMsg, macroTrees, *this);
+		macroTrees.emplace(name, tree ? RegularExpression::makeShared<RegularExpression::MacroNode>(tree) : nullptr);
 		return &i->second;
 	}
 
@@ -189,8 +260,8 @@ namespace NanoLexer
 		std::string postfixMsg = " in expression '";
 		postfixMsg += name_;
 		postfixMsg += "'";
-		auto tree = parse(expr, postfixMsg, *this);
-		addLexerTree(lexerName, name_, tree);
+		RegularExpression::ArenaScope arenaScope(arena.get());
+		expreg->tree = parse(expr, postfixMsg, macroTrees, *this);
 		return expreg;
 	}
 
@@ -280,11 +351,19 @@ namespace NanoLexer
 		if (std::get<1>(currentContext).size())
 			closeContext();
 
+		// the nodes and sets created while computing the lexer are released with the generator
+		RegularExpression::ArenaScope arenaScope(arena.get());
+
 		int id = 1;
 		std::string source;
 		std::string declarations;
-		std::ostringstream lexNames, nameCases, exprCases, onMatch;
+		std::ostringstream lexNames, nameCases, exprCases, onMatch, skippedCases, acceptedValues;
+		std::set<int> integerBases;
+		auto interning = false;
 		std::map<std::string, std::shared_ptr<RegularExpression::LexerContext>> contexts;
+		std::vector<std::shared_ptr<RegularExpression::LexerContext>> orderedContexts;		// same order as contextsData
+		std::vector<std::set<int>> contextsPopIds;
+		int mainLexemeCount = 0;
 
 		debugString = "";
 		lexemeCount = 0;
@@ -292,9 +371,13 @@ namespace NanoLexer
 		{
 			std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>  expRegTrees;
 			std::set<int> popIds;
+			std::map<int, int> lexemeBases;
+			std::set<int> internedLexemes;
 			auto& expressions = std::get<1>(context);
 			auto& contextName = std::get<0>(context);
 			auto isMainContext = (contextName == mainContextName);
+			if (isMainContext)
+				mainLexemeCount = (int)expressions.size();
 			for (auto& expr : expressions)
 			{
 				switch (expr.second.getAction())
@@ -321,6 +404,55 @@ namespace NanoLexer
 					break;
 				}
 
+				if (expr.second.skip)
+				{
+					if (isMainContext)
+					{
+						skippedCases << "case Lexeme::" << expr.second.getName() << "_: ";
+					}
+					else
+					{
+						std::string msg = "Cannot skip an expression out of the main context : '";
+						msg += expr.first;
+						msg += "'";
+						addErrorMessage(msg);
+					}
+				}
+				std::string acceptedValue;
+				if (expr.second.integerBase)
+				{
+					if (isMainContext)
+					{
+						lexemeBases.emplace(id, expr.second.integerBase);
+						integerBases.insert(expr.second.integerBase);
+						acceptedValue += "integerValue = integerAccumulator" + std::to_string(expr.second.integerBase) + "; ";
+					}
+					else
+					{
+						std::string msg = "Cannot compute the integer value of an expression out of the main context : '";
+						msg += expr.first;
+						msg += "'";
+						addErrorMessage(msg);
+					}
+				}
+				if (expr.second.interned)
+				{
+					if (isMainContext)
+					{
+						internedLexemes.insert(id);
+						interning = true;
+						acceptedValue += "symbolHash = symbolHashAccumulator; symbolOffset = matchOffset; symbolLength = acceptedLength; ";
+					}
+					else
+					{
+						std::string msg = "Cannot intern an expression out of the main context : '";
+						msg += expr.first;
+						msg += "'";
+						addErrorMessage(msg);
+					}
+				}
+				if (!acceptedValue.empty())
+					acceptedValues << "case Lexeme::" << expr.second.getName() << "_: " << acceptedValue << "break; ";
 				if (!expr.second.matchCode.empty() && isMainContext)
 				{
 					onMatch << "			case Lexeme::" << expr.second.getName() << "_:" << std::endl;
@@ -339,30 +471,79 @@ namespace NanoLexer
 					auto iter = name2expr.find(expr.first);
 					exprCases << "case Lexeme::" << expr.first << "_: return \"" << normalizeExpression(iter->second) << "\";";
 				}
-				auto tree = getLexerTree(lexerName, expr.first);
+				auto tree = expr.second.tree;
 				auto concatNode = std::dynamic_pointer_cast<RegularExpression::ConcatNode>(tree);
 				if (!concatNode)
 				{
-					concatNode = std::make_shared<RegularExpression::ConcatNode>();
+					concatNode = RegularExpression::makeShared<RegularExpression::ConcatNode>();
 					concatNode->addChild(tree);
 				}
-				concatNode->addChild(std::make_unique<RegularExpression::EndNode>(id));
+				concatNode->addChild(RegularExpression::makeShared<RegularExpression::EndNode>(id));
 				expRegTrees.push_back(std::move(concatNode));
 				id++;
 			}
 			auto pair = contexts.emplace(contextName, std::make_shared<RegularExpression::LexerContext>(contextName, (int)expressions.size(), popIds));
 			assert(pair.second);
-			auto context = pair.first->second;
-			context->setExpRegList(std::move(expRegTrees));
-			context->ComputeLexer();
+			auto lexerContext = pair.first->second;
+			lexerContext->setExpRegList(std::move(expRegTrees));
+			if (lexemeBases.size())
+				lexerContext->setIntegerBases(lexemeBases);
+			if (internedLexemes.size())
+				lexerContext->setInternedLexemes(internedLexemes);
+			orderedContexts.push_back(lexerContext);
+			contextsPopIds.push_back(popIds);
+		}
 
-			debugString += context->getDebugString(popIds);
-			lexemeCount += context->getLexemeCount();
+		// the contexts are independent until they are wired by their push actions: their DFA are computed in parallel
+		std::vector<char> completed(orderedContexts.size());
+		RegularExpression::parallelFor(orderedContexts.size(), [&](std::size_t i)
+			{
+				completed[i] = orderedContexts[i]->ComputeLexer(maxStateCount);
+			});
+		auto incomplete = false;
+		for (std::size_t i = 0; i < orderedContexts.size(); i++)
+		{
+			std::string refusal;	// why the position automaton cannot replace the incomplete DFA
+			if (!completed[i] && positionAutomatonFallback && (std::get<0>(contextsData[i]) == mainContextName))
+			{
+				// the main context is simulated from its positions, unless it pushes contexts or computes integer values or hashes
+				const auto& expressions = std::get<1>(contextsData[i]);
+				auto pushes = std::any_of(expressions.begin(), expressions.end(), [](const std::pair<std::string, Expression>& expr) { return expr.second.getAction() == ActionOnMatch::push; });
+				if (pushes)
+					refusal = "it pushes contexts";
+				else if (!integerBases.empty())
+					refusal = "it computes integer values";
+				else if (interning)
+					refusal = "it interns expressions";
+				else if (!orderedContexts[i]->usePositionAutomaton())
+					refusal = "more than " + std::to_string(RegularExpression::PositionAutomaton::maxPositionCount) + " positions";
+				completed[i] = refusal.empty();
+			}
+			if (!completed[i])
+			{
+				std::string msg = "Too many states in context '";
+				msg += orderedContexts[i]->getName();
+				msg += "' : more than ";
+				msg += std::to_string(maxStateCount);
+				if (!refusal.empty())
+					msg += " and no position automaton: " + refusal;
+				addErrorMessage(msg);
+				incomplete = true;
+			}
+		}
+		// the DFA of such a context is incomplete: no need to go further
+		if (incomplete)
+			throw NanoLexerException(errorMessages);
+		for (std::size_t i = 0; i < orderedContexts.size(); i++)
+		{
+			debugString += orderedContexts[i]->getDebugString(contextsPopIds[i]);
+			lexemeCount += orderedContexts[i]->getLexemeCount();
 		}
 		onMatch << "			default:" << std::endl;
 		onMatch << "				{" << defaultOnMatch << "}" << std::endl;
 
-		std::map<int, std::string>	id2OnMatchCode;
+		std::vector<std::map<int, std::string>>	contextsId2OnMatchCode;
+		std::vector<std::string> contextsFailure;
 		id = 1;
 		for (auto& context : contextsData)
 		{
@@ -372,7 +553,7 @@ namespace NanoLexer
 			auto currentContext = iter->second;
 
 			auto& expressions = std::get<1>(context);
-			id2OnMatchCode.clear();
+			auto& id2OnMatchCode = contextsId2OnMatchCode.emplace_back();
 			for (auto& expr : expressions)
 			{
 				if (expr.second.getAction() == ActionOnMatch::push)
@@ -394,26 +575,561 @@ namespace NanoLexer
 			}
 			declarations += currentContext->declareToCpp();
 			auto iterFailure = contextName2contextFailure.find(currentContextName);
-			std::string contextFailure = (iterFailure != contextName2contextFailure.end()) ? iterFailure->second: "";
-			source += currentContext->bodyToCpp(contextFailure, id2OnMatchCode);
+			contextsFailure.push_back((iterFailure != contextName2contextFailure.end()) ? iterFailure->second : "");
+		}
+
+		// the profile counters of a context follow those of the previous ones
+		std::vector<int> firstCounters(orderedContexts.size(), -1);
+		int counterCount = 0;
+		if (profileInstrumentation)
+		{
+			for (std::size_t i = 0; i < orderedContexts.size(); i++)
+			{
+				firstCounters[i] = counterCount;
+				counterCount += orderedContexts[i]->getTransitionCount();
+			}
 		}
-		variables.emplace_back("$(PublicMembers)", publicMembers);
+		std::map<std::string, RegularExpression::ContextProfile> profiles;
+		if (!profile.empty())
+		{
+			// number of transitions of each state of each context, to check the lines of the profile
+			std::map<std::string, std::map<int, std::size_t>> transitionCounts;
+			for (const auto& context : orderedContexts)
+			{
+				auto& counts = transitionCounts[context->getName()];
+				for (const auto* state : context->getStates())
+					counts[state->GetId()] = state->getTransitions().size();
+			}
+
+			std::istringstream lines(profile);
+			int lineNumber = 0;
+			for (std::string line; std::getline(lines, line); )
+			{
+				lineNumber++;
+				std::istringstream fields(line);
+				std::string contextName;
+				int state, transition;
+				unsigned long long count;
+				if (!(fields >> contextName))
+					continue;
+				if (!(fields >> state >> transition >> count) || state < 0 || transition < 0)
+				{
+					addErrorMessage("Invalid line " + std::to_string(lineNumber) + " in the profile");
+					continue;
+				}
+				auto iterContext = transitionCounts.find(contextName);
+				if (iterContext == transitionCounts.end())
+				{
+					addErrorMessage("Unknown context '" + contextName + "' at line " + std::to_string(lineNumber) + " of the profile");
+					continue;
+				}
+				auto iterState = iterContext->second.find(state);
+				if (iterState == iterContext->second.end() || (std::size_t)transition >= iterState->second)
+				{
+					addErrorMessage("Unknown transition " + std::to_string(transition) + " of state " + std::to_string(state) + " of context '" + contextName + "' at line " + std::to_string(lineNumber) + " of the profile");
+					continue;
+				}
+				auto& counts = profiles[contextName][state];
+				counts.resize(iterState->second);
+				counts[transition] += count;
+			}
+			// [[unlikely]] is a C++20 attribute
+			source += "#ifndef NANOLEXER_UNLIKELY\n";
+			source += "#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)\n";
+			source += "#define NANOLEXER_UNLIKELY [[unlikely]]\n";
+			source += "#else\n";
+			source += "#define NANOLEXER_UNLIKELY\n";
+			source += "#endif\n";
+			source += "#endif\n";
+		}
+
+		if (computedGoto)
+		{
+			// labels as values are an extension of GCC and Clang
+			source += "#ifndef NANOLEXER_COMPUTED_GOTO\n";
+			source += "#if defined(__GNUC__)\n";
+			source += "#define NANOLEXER_COMPUTED_GOTO 1\n";
+			source += "#else\n";
+			source += "#define NANOLEXER_COMPUTED_GOTO 0\n";
+			source += "#endif\n";
+			source += "#endif\n";
+		}
+
+		std::string includes;
+		if (scanMode || fixedCapacity)
+			includes += "#include <cstring>\n";
+		if (scanMode)
+			includes += "#include <utility>\n";
+		if (scanMode || interning)
+			includes += "#include <vector>\n";
+		if (fixedCapacity)
+			includes += "#include <string_view>\n";
+		if (runScan || scanMode)
+		{
+			// SSE2 is always available on x86-64, and enabled by -msse2 on x86
+			includes += "#ifndef NANOLEXER_SIMD\n";
+			includes += "#if defined(__SSE2__) || defined(_M_X64)\n";
+			includes += "#define NANOLEXER_SIMD 1\n";
+			includes += "#else\n";
+			includes += "#define NANOLEXER_SIMD 0\n";
+			includes += "#endif\n";
+			includes += "#endif\n";
+			includes += "#if NANOLEXER_SIMD\n";
+			includes += "#include <emmintrin.h>\n";
+			includes += "#ifdef _MSC_VER\n";
+			includes += "#include <intrin.h>\n";
+			includes += "#endif\n";
+			includes += "#endif\n";
+		}
+
+		// once wired, the code of each context is generated in parallel and concatenated in the order of declaration
+		std::vector<std::string> bodies(orderedContexts.size());
+		RegularExpression::parallelFor(orderedContexts.size(), [&](std::size_t i)
+			{
+				auto iterProfile = profiles.find(orderedContexts[i]->getName());
+				const RegularExpression::ContextProfile emptyProfile;
+				const auto* contextProfile = profile.empty() ? nullptr : ((iterProfile != profiles.end()) ? &iterProfile->second : &emptyProfile);
+				bodies[i] = orderedContexts[i]->bodyToCpp(contextsFailure[i], contextsId2OnMatchCode[i], firstCounters[i], contextProfile, computedGoto, runScan);
+			});
+		for (const auto& body : bodies)
+			source += body;
+
+		auto allPublicMembers = publicMembers;
+		auto allPrivateMembers = privateMembers;
+		if (profileInstrumentation)
+		{
+			std::ostringstream members;
+			members << "        // Writes the number of times each transition of the lexer was taken, see LexerGenerator::setProfile()" << std::endl;
+			members << "        template <typename Out>" << std::endl;
+			members << "        void writeProfile(Out& out) const" << std::endl;
+			members << "        {" << std::endl;
+			members << "            static const struct { const char* context; int state; int transition; } transitions[] = {" << std::endl;
+			for (const auto& context : orderedContexts)
+			{
+				for (auto* state : context->getStates())
+				{
+					for (std::size_t t = 0; t < state->getTransitions().size(); t++)
+						members << "                {\"" << context->getName() << "\", " << state->GetId() << ", " << t << "}," << std::endl;
+				}
+			}
+			members << "                {nullptr, 0, 0}" << std::endl;
+			members << "            };" << std::endl;
+			members << "            for (int i = 0; transitions[i].context; i++)" << std::endl;
+			members << "            {" << std::endl;
+			members << "                if (profileCounters[i])" << std::endl;
+			members << "                    out << transitions[i].context << ' ' << transitions[i].state << ' ' << transitions[i].transition << ' ' << profileCounters[i] << '\\n';" << std::endl;
+			members << "            }" << std::endl;
+			members << "        }" << std::endl;
+			allPublicMembers += "\n";
+			allPublicMembers += members.str();
+			allPrivateMembers += "\n        unsigned long long profileCounters[" + std::to_string(counterCount + 1) + "] = {};\n";
+		}
+		if (integerBases.size())
+		{
+			std::ostringstream members;
+			members << "        // value of the last lexeme whose expression computes it, see Expression::setIntegerValue()" << std::endl;
+			members << "        inline unsigned long long getIntegerValue() const {return integerValue;}" << std::endl;
+			allPublicMembers += "\n";
+			allPublicMembers += members.str();
+			members.str("");
+			members << "        unsigned long long integerValue = 0;" << std::endl;
+			for (auto base : integerBases)
+				members << "        unsigned long long integerAccumulator" << base << " = 0;" << std::endl;
+			members << std::endl;
+			members << "        // value of c as a digit, 99 if it is not one" << std::endl;
+			members << "        static inline int digitValue(int c)" << std::endl;
+			members << "        {" << std::endl;
+			members << "            if (c >= '0' && c <= '9')" << std::endl;
+			members << "                return c - '0';" << std::endl;
+			members << "            if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')" << std::endl;
+			members << "                return (c | 0x20) - 'a' + 10;" << std::endl;
+			members << "            return 99;" << std::endl;
+			members << "        }" << std::endl;
+			allPrivateMembers += "\n";
+			allPrivateMembers += members.str();
+		}
+		if (interning)
+		{
+			std::ostringstream members;
+			members << "        // id of the last lexeme whose expression is interned (Expression::setInterned()), the same for the same text:" << std::endl;
+			members << "        // it is looked up with the hash computed while it was read, and its text is copied only when it is new." << std::endl;
+			members << "        // Returns (unsigned)-1 when the last lexeme is not interned: the hash is that of another span of the input" << std::endl;
+			members << "        unsigned getSymbolId()" << std::endl;
+			members << "        {" << std::endl;
+			members << "            if (symbolOffset != matchOffset || symbolLength != matchString.size())" << std::endl;
+			members << "                return (unsigned)-1;" << std::endl;
+			members << "            if (2 * (symbols.size() + 1) > symbolSlots.size())" << std::endl;
+			members << "                rehashSymbols();" << std::endl;
+			members << "            auto mask = symbolSlots.size() - 1;" << std::endl;
+			members << "            for (auto slot = symbolHash & mask; ; slot = (slot + 1) & mask)" << std::endl;
+			members << "            {" << std::endl;
+			members << "                auto& id = symbolSlots[slot];" << std::endl;
+			members << "                if (id == 0)" << std::endl;
+			members << "                {" << std::endl;
+			members << "                    symbols.push_back({ symbolText.size(), matchString.size(), symbolHash });" << std::endl;
+			members << "                    symbolText += matchString;" << std::endl;
+			members << "                    id = (unsigned)symbols.size();" << std::endl;
+			members << "                    return id - 1;" << std::endl;
+			members << "                }" << std::endl;
+			members << "                const auto& symbol = symbols[id - 1];" << std::endl;
+			members << "                if (symbol.hash == symbolHash && symbol.length == matchString.size() && symbolText.compare(symbol.offset, symbol.length, matchString) == 0)" << std::endl;
+			members << "                    return id - 1;" << std::endl;
+			members << "            }" << std::endl;
+			members << "        }" << std::endl;
+			members << "        inline std::string getSymbolText(unsigned id) const {return symbolText.substr(symbols[id].offset, symbols[id].length);}" << std::endl;
+			members << "        inline std::size_t getSymbolCount() const {return symbols.size();}" << std::endl;
+			allPublicMembers += "\n";
+			allPublicMembers += members.str();
+			members.str("");
+			members << "        struct Symbol" << std::endl;
+			members << "        {" << std::endl;
+			members << "            std::size_t offset;     // of its text in symbolText" << std::endl;
+			members << "            std::size_t length;" << std::endl;
+			members << "            unsigned    hash;" << std::endl;
+			members << "        };" << std::endl;
+			members << "        unsigned                symbolHash = 0;             // FNV-1a of the last lexeme interned" << std::endl;
+			members << "        std::size_t             symbolOffset = (std::size_t)-1;   // and its span in the input" << std::endl;
+			members << "        std::size_t             symbolLength = 0;" << std::endl;
+			members << "        unsigned                symbolHashAccumulator = 0;" << std::endl;
+			members << "        std::vector<Symbol>     symbols;                    // by id" << std::endl;
+			members << "        std::vector<unsigned>   symbolSlots;                // open addressing, linear probing: id + 1, 0 when empty" << std::endl;
+			members << "        std::string             symbolText;                 // texts of the symbols, end to end" << std::endl;
+			members << std::endl;
+			members << "        // doubles the slots (64 at first), kept at most half full" << std::endl;
+			members << "        void rehashSymbols()" << std::endl;
+			members << "        {" << std::endl;
+			members << "            std::vector<unsigned> slots(symbolSlots.empty() ? 64 : 2 * symbolSlots.size());" << std::endl;
+			members << "            auto mask = slots.size() - 1;" << std::endl;
+			members << "            for (unsigned id = 0; id < symbols.size(); id++)" << std::endl;
+			members << "            {" << std::endl;
+			members << "                auto slot = symbols[id].hash & mask;" << std::endl;
+			members << "                while (slots[slot])" << std::endl;
+			members << "                    slot = (slot + 1) & mask;" << std::endl;
+			members << "                slots[slot] = id + 1;" << std::endl;
+			members << "            }" << std::endl;
+			members << "            symbolSlots.swap(slots);" << std::endl;
+			members << "        }" << std::endl;
+			allPrivateMembers += "\n";
+			allPrivateMembers += members.str();
+		}
+		if (scanMode)
+		{
+			std::ostringstream members;
+			members << "        // Finds the next match of a lexeme of the main context anywhere in the input, see LexerGenerator::setScanMode():" << std::endl;
+			members << "        // the leftmost match, and the longest one at its offset. The input before it is skipped by skipToMatch(), then the" << std::endl;
+			members << "        // match is read by the main context. The skipped expressions are matched but not returned." << std::endl;
+			members << "        Lexeme findNextToken()" << std::endl;
+			members << "        {" << std::endl;
+			members << "            while (true)" << std::endl;
+			members << "            {" << std::endl;
+			members << "                skipToMatch();" << std::endl;
+			members << "                matchString.clear();" << std::endl;
+			members << "                accepted = Lexeme::unknown_;" << std::endl;
+			members << "                matchOffset = nextOffset;" << std::endl;
+			members << "                nbRead = 0;" << std::endl;
+			members << "                acceptedLength = 0;" << std::endl;
+			members << "                main_context();" << std::endl;
+			members << "                if (accepted == Lexeme::eof_)" << std::endl;
+			members << "                    return accepted;" << std::endl;
+			members << "                // only a lexeme pushing a context, or the position automaton, can fail there: its first byte is skipped" << std::endl;
+			members << "                auto length = (accepted != Lexeme::unknown_) ? acceptedLength : 1;" << std::endl;
+			members << "                unget(nbRead - length);" << std::endl;
+			members << "                if (accepted != Lexeme::unknown_)" << std::endl;
+			members << "                {" << std::endl;
+			members << "#ifdef NANOLEXER_STATS" << std::endl;
+			members << "                    stats.counts[(int)accepted + Stats::lexemeOffset]++;" << std::endl;
+			members << "                    stats.bytes[(int)accepted + Stats::lexemeOffset] += nbRead;" << std::endl;
+			members << "#endif" << std::endl;
+			members << "                    onMatch();" << std::endl;
+			members << "                }" << std::endl;
+			members << "                endMatch();" << std::endl;
+			members << "                if (accepted != Lexeme::unknown_ && !isSkipped(accepted))" << std::endl;
+			members << "                    return accepted;" << std::endl;
+			members << "            }" << std::endl;
+			members << "        }" << std::endl;
+			allPublicMembers += "\n";
+			allPublicMembers += members.str();
+		}
+		if (runScan || scanMode)
+		{
+			std::ostringstream members;
+			if (scanMode)
+			{
+				members << "        static constexpr std::size_t scanReadSize = 4096;" << std::endl;
+				members << std::endl;
+				members << "        // Skips the input up to the leftmost offset from which the DFA of the main context reaches an accepting state. The" << std::endl;
+				members << "        // attempts from all the offsets run together on the tables of scanStep(), in the order of their offsets, and those" << std::endl;
+				members << "        // in the same state share their future: only the first one is kept, so that each byte is read once per state. The" << std::endl;
+				members << "        // search ends when an attempt accepts and those starting before it have failed. The input is read ahead in buf by" << std::endl;
+				members << "        // blocks, and the bytes that cannot start a match are skipped with findCandidate() while no attempt is running." << std::endl;
+				members << "        void skipToMatch()" << std::endl;
+				members << "        {" << std::endl;
+				members << "            scanAttempts.clear();" << std::endl;
+				members << "            bool found = false;" << std::endl;
+				members << "            std::size_t foundOffset = 0;        // offset of the leftmost attempt accepting" << std::endl;
+				members << "            std::size_t pos = bufPos;           // index in buf of the next byte to read" << std::endl;
+				members << "            while (true)" << std::endl;
+				members << "            {" << std::endl;
+				members << "                if (scanAttempts.empty())" << std::endl;
+				members << "                {" << std::endl;
+				members << "                    if (found)" << std::endl;
+				members << "                        break;" << std::endl;
+				members << "                    skip(pos - bufPos);" << std::endl;
+				members << "                    pos = findCandidate(buf.data() + pos, buf.data() + buf.size()) - buf.data();" << std::endl;
+				members << "                    skip(pos - bufPos);" << std::endl;
+				members << "                }" << std::endl;
+				members << "                if (pos == buf.size())" << std::endl;
+				members << "                {" << std::endl;
+				members << "                    // reads the next block, keeping the bytes from the first attempt running" << std::endl;
+				members << "                    if (scanAttempts.size())" << std::endl;
+				members << "                        skip(scanAttempts.front().first - nextOffset);" << std::endl;
+				members << "                    buf.erase(0, bufPos);" << std::endl;
+				members << "                    pos -= bufPos;" << std::endl;
+				members << "                    bufPos = 0;" << std::endl;
+				members << "                    auto size = buf.size();" << std::endl;
+				members << "                    buf.resize(size + scanReadSize);" << std::endl;
+				members << "                    buf.resize(size + (std::size_t)inputStream.rdbuf()->sgetn(&buf[size], scanReadSize));" << std::endl;
+				members << "                    if (buf.size() == size)" << std::endl;
+				members << "                    {" << std::endl;
+				members << "                        // the attempts running fail at the end of the input" << std::endl;
+				members << "                        if (!found)" << std::endl;
+				members << "                            skip(pos - bufPos);" << std::endl;
+				members << "                        break;" << std::endl;
+				members << "                    }" << std::endl;
+				members << "                }" << std::endl;
+				members << "                if (!found)" << std::endl;
+				members << "                    scanAttempts.emplace_back(nextOffset + (pos - bufPos), 0);" << std::endl;
+				members << "                int c = (unsigned char)buf[pos++];" << std::endl;
+				members << "                scanCount++;" << std::endl;
+				members << "                std::size_t kept = 0;" << std::endl;
+				members << "                for (const auto& attempt : scanAttempts)" << std::endl;
+				members << "                {" << std::endl;
+				members << "                    int next = scanStep(attempt.second, c);" << std::endl;
+				members << "                    if (next < 0 || scanStamps[next] == scanCount)" << std::endl;
+				members << "                        continue;" << std::endl;
+				members << "                    scanStamps[next] = scanCount;" << std::endl;
+				members << "                    if (scanAccepts(next))" << std::endl;
+				members << "                    {" << std::endl;
+				members << "                        // the attempts starting after this one cannot be the leftmost match" << std::endl;
+				members << "                        found = true;" << std::endl;
+				members << "                        foundOffset = attempt.first;" << std::endl;
+				members << "                        break;" << std::endl;
+				members << "                    }" << std::endl;
+				members << "                    scanAttempts[kept++] = {attempt.first, next};" << std::endl;
+				members << "                }" << std::endl;
+				members << "                scanAttempts.resize(kept);" << std::endl;
+				members << "            }" << std::endl;
+				members << "            if (found)" << std::endl;
+				members << "                skip(foundOffset - nextOffset);" << std::endl;
+				members << "        }" << std::endl;
+				members << std::endl;
+				members << "        // consumes the next 'count' bytes of buf, which are not part of a match" << std::endl;
+				members << "        void skip(std::size_t count)" << std::endl;
+				members << "        {" << std::endl;
+				members << "#ifdef NANOLEXER_LINE_INDEX" << std::endl;
+				members << "            lineIndex.add(buf.data() + bufPos, count, nextOffset);" << std::endl;
+				members << "#endif" << std::endl;
+				members << "            nextOffset += count;" << std::endl;
+				members << "            bufPos += count;" << std::endl;
+				members << "        }" << std::endl;
+				members << std::endl;
+				members << orderedContexts[0]->scanStepsToCpp();
+				members << std::endl;
+				members << "        // first byte of [begin, end) that can start a match, or end" << std::endl;
+				members << orderedContexts[0]->candidateFinderToCpp();
+				members << std::endl;
+				members << "        std::vector<std::pair<std::size_t, int>>    scanAttempts;   // offset and state of the attempts running" << std::endl;
+				members << "        std::vector<unsigned long long>  scanStamps = std::vector<unsigned long long>(scanStateCount);    // scanCount when each state was last reached" << std::endl;
+				members << "        unsigned long long  scanCount = 0;  // bytes read by skipToMatch()" << std::endl;
+				members << std::endl;
+			}
+			members << "#if NANOLEXER_SIMD" << std::endl;
+			if (runScan)
+			{
+				members << "        static constexpr std::size_t runReadSize = 4096;" << std::endl;
+				members << std::endl;
+				members << "        // Consumes the bytes of the input for which 'inSet' (a bitmask of 64 bytes) is set, by blocks of 64 bytes read" << std::endl;
+				members << "        // ahead in buf. The last bytes of the input, fewer than 64, are left to get()." << std::endl;
+				members << "        template <typename InSet>" << std::endl;
+				members << "        void skipRun(InSet inSet)" << std::endl;
+				members << "        {" << std::endl;
+				members << "            while (true)" << std::endl;
+				members << "            {" << std::endl;
+				members << "                if (buf.size() - bufPos < 64)" << std::endl;
+				members << "                {" << std::endl;
+				members << "                    buf.erase(0, bufPos);" << std::endl;
+				members << "                    bufPos = 0;" << std::endl;
+				members << "                    auto size = buf.size();" << std::endl;
+				members << "                    buf.resize(size + runReadSize);" << std::endl;
+				members << "                    buf.resize(size + (std::size_t)inputStream.rdbuf()->sgetn(&buf[size], runReadSize));" << std::endl;
+				members << "                    if (buf.size() < 64)" << std::endl;
+				members << "                        return;" << std::endl;
+				members << "                }" << std::endl;
+				members << "                auto inRun = ~inSet(buf.data() + bufPos);" << std::endl;
+				members << "                int run = inRun ? countTrailingZeros(inRun) : 64;" << std::endl;
+				members << "                matchString.append(buf, bufPos, run);" << std::endl;
+				members << "                bufPos += run;" << std::endl;
+				members << "                nbRead += run;" << std::endl;
+				members << "                if (run < 64)" << std::endl;
+				members << "                    return;" << std::endl;
+				members << "            }" << std::endl;
+				members << "        }" << std::endl;
+				members << std::endl;
+			}
+			members << "        static inline int countTrailingZeros(unsigned long long m)" << std::endl;
+			members << "        {" << std::endl;
+			members << "#ifdef _MSC_VER" << std::endl;
+			members << "            unsigned long i;" << std::endl;
+			members << "            _BitScanForward64(&i, m);" << std::endl;
+			members << "            return (int)i;" << std::endl;
+			members << "#else" << std::endl;
+			members << "            return __builtin_ctzll(m);" << std::endl;
+			members << "#endif" << std::endl;
+			members << "        }" << std::endl;
+			members << std::endl;
+			members << "        // 0xFF for the bytes of x in [lo, lo + span], compared unsigned" << std::endl;
+			members << "        static inline __m128i bytesInRange(__m128i x, int lo, int span)" << std::endl;
+			members << "        {" << std::endl;
+			members << "            auto d = _mm_sub_epi8(x, _mm_set1_epi8((char)lo));" << std::endl;
+			members << "            return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8((char)span)), d);" << std::endl;
+			members << "        }" << std::endl;
+			members << "#endif" << std::endl;
+			allPrivateMembers += "\n";
+			allPrivateMembers += members.str();
+		}
+		// the match and the input read ahead, in strings or, with a fixed capacity, in arrays of the lexer
+		std::string bufferType = "        using Buffer = std::string;";
+		std::string errorLexemes, checkCapacity, checkOverflow;
+		int errorLexemeCount = 0;	// declared before unknown_, from -2 down
+		if (fixedCapacity)
+		{
+			if (runScan || scanMode || interning)
+				addErrorMessage("A fixed capacity cannot be combined with the run scan, the scan mode or interned expressions");
+			std::ostringstream buffer;
+			buffer << "        // the match and the input read ahead, in the lexer so that it never allocates, see LexerGenerator::setFixedCapacity()" << std::endl;
+			buffer << "        class Buffer" << std::endl;
+			buffer << "        {" << std::endl;
+			buffer << "        public:" << std::endl;
+			buffer << "            static constexpr std::size_t capacity = " << fixedCapacity + 1 << ";    // the longest match and a byte read after it" << std::endl;
+			buffer << std::endl;
+			buffer << "            inline std::size_t size() const {return length;}" << std::endl;
+			buffer << "            inline const char* data() const {return bytes;}" << std::endl;
+			buffer << "            inline char& operator[](std::size_t i) {return bytes[i];}" << std::endl;
+			buffer << "            inline void clear() {length = 0;}" << std::endl;
+			buffer << "            inline void resize(std::size_t size) {length = size;}    // only to shrink" << std::endl;
+			buffer << "            inline Buffer& operator+=(char c) {bytes[length++] = c; return *this;}" << std::endl;
+			buffer << "            void replace(std::size_t position, std::size_t count, const char* s, std::size_t n)" << std::endl;
+			buffer << "            {" << std::endl;
+			buffer << "                std::memmove(bytes + position + n, bytes + position + count, length - position - count);" << std::endl;
+			buffer << "                std::memcpy(bytes + position, s, n);" << std::endl;
+			buffer << "                length += n - count;" << std::endl;
+			buffer << "            }" << std::endl;
+			buffer << "            inline operator std::string_view() const {return {bytes, length};}" << std::endl;
+			buffer << std::endl;
+			buffer << "        private:" << std::endl;
+			buffer << "            char            bytes[capacity];" << std::endl;
+			buffer << "            std::size_t     length = 0;" << std::endl;
+			buffer << "        };";
+			bufferType = buffer.str();
+			errorLexemes = "\t\t\toverflow_ = -2,\t// the match exceeds the capacity, see LexerGenerator::setFixedCapacity()\n";
+			errorLexemeCount = 1;
+			nameCases << std::endl << "                case Lexeme::overflow_: return \"overflow\";";
+			exprCases << std::endl << "                case Lexeme::overflow_: return \"<OVERFLOW>\";";
+			// the bytes put back come from the match: with it, they never exceed the capacity
+			checkCapacity += "            if (matchString.size() == Buffer::capacity)\n";
+			checkCapacity += "            {\n";
+			checkCapacity += "                overflow = true;    // the match is cut, reported by getNextToken()\n";
+			checkCapacity += "                return Traits::eof();\n";
+			checkCapacity += "            }\n";
+			checkOverflow += "                if (overflow)\n";
+			checkOverflow += "                {\n";
+			checkOverflow += "                    // the bytes read are consumed but the last one, after the longest match allowed\n";
+			checkOverflow += "                    overflow = false;\n";
+			checkOverflow += "                    unget(1);\n";
+			checkOverflow += "                    accepted = Lexeme::overflow_;\n";
+			checkOverflow += "#ifdef NANOLEXER_STATS\n";
+			checkOverflow += "                    stats.counts[(int)accepted + Stats::lexemeOffset]++;\n";
+			checkOverflow += "                    stats.bytes[(int)accepted + Stats::lexemeOffset] += matchString.size();\n";
+			checkOverflow += "#endif\n";
+			checkOverflow += "                    endMatch();\n";
+			checkOverflow += "                    return accepted;\n";
+			checkOverflow += "                }\n";
+			allPrivateMembers += "\n        bool overflow = false;\n";
+		}
+		variables.emplace_back("$(BufferType)", bufferType);
+		variables.emplace_back("$(MatchStringType)", fixedCapacity ? "std::string_view" : "const std::string&");
+		variables.emplace_back("$(ErrorLexemes)", errorLexemes);
+		variables.emplace_back("$(CheckCapacity)", checkCapacity);
+		variables.emplace_back("$(CheckOverflow)", checkOverflow);
+		variables.emplace_back("$(PublicMembers)", allPublicMembers);
 		variables.emplace_back("$(ProtectedMembers)", protectedMembers);
-		variables.emplace_back("$(PrivateMembers)", privateMembers);
+		variables.emplace_back("$(PrivateMembers)", allPrivateMembers);
 		variables.emplace_back("$(OnCreate)", onCreate);
 		variables.emplace_back("$(OnStartNextToken)", onStartNextToken);
 		variables.emplace_back("$(OnMatch)", onMatch.str());
 
 		variables.emplace_back("$(Declarations)", declarations);
+		variables.emplace_back("$(Includes)", includes);
 		variables.emplace_back("$(LexerContextsMethods)", source);
 		variables.emplace_back("$(LexemeNames)", lexNames.str());
+		variables.emplace_back("$(LexemeCount)", std::to_string(mainLexemeCount + 2 + errorLexemeCount));
+		variables.emplace_back("$(LexemeOffset)", std::to_string(1 + errorLexemeCount));
 		variables.emplace_back("$(GetLexemeNamesCases)", nameCases.str());
 		variables.emplace_back("$(GetLexemeExpressionsCases)", exprCases.str());
+		if (skippedCases.tellp() > 0)
+			skippedCases << "return true;";
+		variables.emplace_back("$(SkippedCases)", skippedCases.str());
+		variables.emplace_back("$(AcceptedValues)", acceptedValues.str());
 
 		if (!errorMessages.empty())
 			throw NanoLexerException(errorMessages);
 	}
 
+	void LexerGenerator::setMaxStateCount(int count)
+	{
+		maxStateCount = count;
+	}
+
+	void LexerGenerator::setPositionAutomatonFallback(bool fallback)
+	{
+		positionAutomatonFallback = fallback;
+	}
+
+	void LexerGenerator::setProfileInstrumentation(bool instrument)
+	{
+		profileInstrumentation = instrument;
+	}
+
+	void LexerGenerator::setProfile(const std::string& profile_)
+	{
+		profile = profile_;
+	}
+
+	void LexerGenerator::setComputedGoto(bool computedGoto_)
+	{
+		computedGoto = computedGoto_;
+	}
+
+	void LexerGenerator::setRunScan(bool runScan_)
+	{
+		runScan = runScan_;
+	}
+
+	void LexerGenerator::setScanMode(bool scanMode_)
+	{
+		scanMode = scanMode_;
+	}
+
+	void LexerGenerator::setFixedCapacity(int maxMatchLength)
+	{
+		if (maxMatchLength < 0)
+		{
+			addErrorMessage("Invalid capacity " + std::to_string(maxMatchLength));
+			return;
+		}
+		fixedCapacity = maxMatchLength;
+	}
+
 	std::string readFile(const std::filesystem::path& file)
 	{
 		std::ostringstream skeleton;
@@ -433,31 +1149,45 @@ namespace NanoLexer
 		myfile.close();
 	}
 
-	void LexerGenerator::generateFiles(const std::string& language, const std::string& outputPath)
+	namespace
 	{
-		std::filesystem::path exePath = getexepath();
-		exePath.remove_filename();
-		auto lexer_sk = exePath;
-
-		lexer_sk = lexer_sk / "lexer_sk";
-		if (!std::filesystem::is_directory(lexer_sk))
+		// Reads all the skeleton files of a directory, sorted by name so that the hash of the model does not depend on the file system.
+		std::vector<std::pair<std::filesystem::path, std::string>> readSkeletons(const std::filesystem::path& directory)
 		{
-			std::cout << "Bad install, missing directory lexer_sk " << lexer_sk.string() << std::endl;
-			return;
+			std::vector<std::pair<std::filesystem::path, std::string>> skeletons;
+			for (auto& file : std::filesystem::directory_iterator(directory))
+				skeletons.emplace_back(file.path(), readFile(file.path()));
+			std::sort(skeletons.begin(), skeletons.end());
+			return skeletons;
 		}
 
-		auto cpp = lexer_sk / language;
-		if (!std::filesystem::is_directory(cpp))
+		std::string concatSkeletons(const std::vector<std::pair<std::filesystem::path, std::string>>& skeletons)
 		{
-			std::cout << "Missing directory lexer_sk/" << language << std::endl;
-			return;
+			std::string str;
+			for (const auto& skeleton : skeletons)
+			{
+				str += skeleton.first.filename().string();
+				str += "\n";
+				str += skeleton.second;
+			}
+			return str;
 		}
+	}
 
-		std::string line;
-		for (auto& file : std::filesystem::directory_iterator(cpp))
+	void LexerGenerator::generateFiles(const std::string& language, const std::string& outputPath)
+	{
+		auto exePath = getExeDirectory();
+		auto skeletonPath = getSkeletonDirectory(exePath, language);
+		if (skeletonPath.empty())
+			return;
+
+		auto skeletons = readSkeletons(skeletonPath);
+		auto allVariables = variables;
+		allVariables.emplace_back(modelHashVariable, computeModelHash(concatSkeletons(skeletons)));
+		for (const auto& skeleton : skeletons)
 		{
-			auto str = readFile(file.path());
-			for (const auto& pair : variables)
+			auto str = skeleton.second;
+			for (const auto& pair : allVariables)
 			{
 				std::size_t n = 0;
 				while ((n = str.find(pair.first, n)) != std::string::npos)
@@ -466,13 +1196,74 @@ namespace NanoLexer
 				}
 			}
 
-			auto filename = lexerName + file.path().filename().string();
+			auto filename = lexerName + skeleton.first.filename().string();
 			auto myPath = exePath / outputPath / filename;
-			writeFile(myPath, str);
+			// an unchanged file is not rewritten, so that its dependencies are not rebuilt
+			if (!std::filesystem::exists(myPath) || readFile(myPath) != str)
+				writeFile(myPath, str);
 		}
 		std::cout << "Lexer " << lexerName << " generated." << std::endl;
 	}
 
+	bool LexerGenerator::isUpToDate(const std::string& language, const std::string& outputPath)
+	{
+		auto exePath = getExeDirectory();
+		auto skeletonPath = getSkeletonDirectory(exePath, language);
+		if (skeletonPath.empty())
+			return false;
+
+		auto skeletons = readSkeletons(skeletonPath);
+		auto hash = computeModelHash(concatSkeletons(skeletons));
+		for (const auto& skeleton : skeletons)
+		{
+			// a skeleton without the placeholder cannot tell from which model its generated file comes
+			if (skeleton.second.find(modelHashVariable) == std::string::npos)
+				return false;
+			auto myPath = exePath / outputPath / (lexerName + skeleton.first.filename().string());
+			if (!std::filesystem::exists(myPath))
+				return false;
+			if (readFile(myPath).find(hash) == std::string::npos)
+				return false;
+		}
+		std::cout << "Lexer " << lexerName << " is up to date." << std::endl;
+		return true;
+	}
+
+	std::unique_ptr<Matcher> LexerGenerator::createMatcher(int maxStateCount_)
+	{
+		if (errorMessages.size())
+			throw NanoLexerException(errorMessages);
+
+		// the main context is the first one closed, unless it is still the current one
+		const auto* mainContext = &currentContext;
+		for (const auto& context : contextsData)
+		{
+			if (std::get<0>(context) == mainContextName)
+			{
+				mainContext = &context;
+				break;
+			}
+		}
+		// the trees of the matcher are parsed again: the positions of a tree belong to a single context
+		std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>> trees;
+		if (std::get<0>(*mainContext) == mainContextName)
+		{
+			int id = 1;
+			for (const auto& expr : std::get<1>(*mainContext))
+			{
+				std::vector<std::string> messages;
+				auto tree = parseString(expr.second.getExpression().c_str(), "", macroTrees, messages);
+				if (messages.size())
+					throw NanoLexerException(messages);
+				auto concatNode = RegularExpression::makeShared<RegularExpression::ConcatNode>();
+				concatNode->addChild(tree);
+				concatNode->addChild(RegularExpression::makeShared<RegularExpression::EndNode>(id++));
+				trees.push_back(std::move(concatNode));
+			}
+		}
+		return std::unique_ptr<Matcher>(new Matcher(std::move(trees), maxStateCount_));
+	}
+
 	std::string LexerGenerator::getDebugString()
 	{
 		return debugString;
@@ -531,6 +1322,105 @@ namespace NanoLexer
 		return &std::get<1>(currentContext).back().second;
 	}
 
+	std::string LexerGenerator::computeModelHash(const std::string& skeletons) const
+	{
+		ModelHasher hasher;
+		hasher.add(generatorVersion);
+		hasher.add(lexerName);
+
+		auto addContext = [&hasher](const std::tuple<std::string, std::vector<std::pair<std::string, Expression>>>& context)
+		{
+			hasher.add(std::get<0>(context));
+			for (const auto& expr : std::get<1>(context))
+			{
+				hasher.add(expr.first);
+				hasher.add(expr.second.expr);
+				hasher.add(expr.second.matchCode);
+				hasher.add(std::to_string((int)expr.second.action));
+				hasher.add(expr.second.pushedContext);
+				if (expr.second.skip)
+					hasher.add("skip");
+				if (expr.second.integerBase)
+					hasher.add("integer base " + std::to_string(expr.second.integerBase));
+				if (expr.second.interned)
+					hasher.add("interned");
+			}
+		};
+		for (const auto& context : contextsData)
+			addContext(context);
+		// the current context is closed by generateLexer() only if it contains expressions
+		if (std::get<1>(currentContext).size())
+			addContext(currentContext);
+
+		for (const auto& macro : macros)
+		{
+			hasher.add(macro.first);
+			hasher.add(macro.second.expr);
+		}
+
+		hasher.add(publicMembers);
+		hasher.add(protectedMembers);
+		hasher.add(privateMembers);
+		hasher.add(onCreate);
+		hasher.add(onStartNextToken);
+		hasher.add(defaultOnMatch);
+		for (const auto& pair : contextName2contextFailure)
+		{
+			hasher.add(pair.first);
+			hasher.add(pair.second);
+		}
+
+		// the options changing the generated code, only when set so that the hash of the other models does not change
+		if (profileInstrumentation)
+			hasher.add("profile instrumentation");
+		if (!profile.empty())
+			hasher.add(profile);
+		if (computedGoto)
+			hasher.add("computed goto");
+		if (runScan)
+			hasher.add("run scan");
+		if (scanMode)
+			hasher.add("scan mode");
+		if (positionAutomatonFallback)
+			hasher.add("position automaton fallback");
+		if (maxStateCount)
+			hasher.add("max state count " + std::to_string(maxStateCount));
+		if (fixedCapacity)
+			hasher.add("fixed capacity " + std::to_string(fixedCapacity));
+
+		hasher.add(skeletons);
+		return hasher.toString();
+	}
+
+	///////////////////////////////////////////////////////// Matcher ////////////////////////////////////////////////////
+
+	Matcher::Matcher(std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>&& trees, int maxStateCount)
+		:context{ std::make_unique<RegularExpression::LexerContext>(mainContextName, (int)trees.size(), std::set<int>()) }
+	{
+		context->setExpRegList(std::move(trees));
+		context->computePositions();
+		dfa = std::make_unique<RegularExpression::LazyDfa>(context->getFirstPositions(), context->getFollowPositions(), (std::size_t)std::max(maxStateCount, 0));
+	}
+
+	Matcher::~Matcher()
+	{
+	}
+
+	int Matcher::longestMatch(const char* begin, const char* end, std::size_t& length)
+	{
+		return dfa->longestMatch(begin, end, length);
+	}
+
+	std::size_t Matcher::getStateCount() const
+	{
+		return dfa->getStateCount();
+	}
+
+	std::size_t Matcher::getFlushCount() const
+	{
+		return dfa->getFlushCount();
+	}
+
 	///////////////////////////////////////////////////////// NanoLexerException ////////////////////////////////////////////////////
 
 	NanoLexerException::NanoLexerException(const std::vector<std::string>& messages_) :messages{ messages_ } {}
@@ -13,45 +13,56 @@
 	#define TRACE_FILE_DEBUG "trace_bison.txt"
 	FILE *traceFile=nullptr;
 	#define stderr traceFile
-#endif YYDEBUG
+#endif // YYDEBUG
 
 #include "../../NanoLexer/LexerTreeNode.h"
-
-void initLexer();
-int getPreviousLexerPosition();
-
-int yylex (void);
-void yyerror(const char*s);
+#include "../../NanoLexer/shared.h"
 
 int hexaDigit2int(char h);
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> findMacro(const std::string &name);
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMin(std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min);
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMinMax(std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min, int max);
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRepeat(std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int count);
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> findMacro(ParsingContext& context, const std::string &name);
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMin(ParsingContext& context, std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min);
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMinMax(ParsingContext& context, std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min, int max);
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRepeat(ParsingContext& context, std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int count);
+void addCodePoints(ParsingContext& context, int min, int max);
+void addProperty(ParsingContext& context, const std::string& name, bool inverse);
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createUnicodeClass(ParsingContext& context, bool inverse);
 
-std::map<std::string, std::shared_ptr<RegularExpression::BaseLexerTreeNode>> mapTree;
+void addParsingErrorMessage(ParsingContext& context, const std::string& msg);
 
-std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>	stackNodes;
-std::vector<std::shared_ptr<RegularExpression::Set>> stackSet;
+template <typename T>
+std::shared_ptr<T> popSet(ParsingContext& context);
 
-void addParsingErrorMessage(const std::string& msg);
-std::vector<std::string>		errorMessages;
-std::string						postfixMsg;
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> popNode(ParsingContext& context);
+%}
 
-// shared globals
-std::string macroName;
+%code requires {
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+struct ParsingContext;
+}
 
-template <typename T>
-std::shared_ptr<T> popSet();
+%code {
+int yylex(YYSTYPE* lvalp, yyscan_t scanner);
+void yyerror(ParsingContext& context, yyscan_t scanner, const char*s);
+}
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> popNode();
-%}
+// pure parser: all the state is in the context, see shared.h
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {ParsingContext& context} {yyscan_t scanner}
 
 %token <character> _INT_DIGIT_
 %token <character> _HEXA_LETTER_
 %token <character> _CHAR_
 %token <id> _MACRO_
 %token _PREFIX_
+%token <number> _CODE_POINT_	// \u{hexa}
+
+// Unicode properties (\p{name} and \P{name})
+%token _PROPERTY_
+%token _NOT_PROPERTY_
 
 // character sets
 %token _ALPHA_
@@ -96,8 +107,8 @@ std::shared_ptr<RegularExpression::BaseLexerTreeNode> popNode();
 l_reg_exp :
   l_reg_exp reg_exp
 	{
-		auto node2 = popNode();
-		auto node1 = popNode();
+		auto node2 = popNode(context);
+		auto node1 = popNode(context);
 		auto concat = std::dynamic_pointer_cast<RegularExpression::ConcatNode>(node1);
 		if (concat)
 		{
@@ -105,11 +116,11 @@ l_reg_exp :
 		}
 		else
 		{
-			concat = std::make_shared<RegularExpression::ConcatNode>();
+			concat = RegularExpression::makeShared<RegularExpression::ConcatNode>();
 			concat->addChild(node1);
 			concat->addChild(node2);
 		}
-		stackNodes.push_back(concat);
+		context.stackNodes.push_back(concat);
 	}
 |           reg_exp
 ;
@@ -117,75 +128,98 @@ l_reg_exp :
 reg_exp :
   single_char
     {
-		auto interval = popSet<RegularExpression::Interval>();
-		auto multiInterval = std::make_shared<RegularExpression::MultiInterval>();
+		auto interval = popSet<RegularExpression::Interval>(context);
+		auto multiInterval = RegularExpression::makeShared<RegularExpression::MultiInterval>();
 		multiInterval->addInterval(*interval.get());
-		stackNodes.push_back(std::make_shared<RegularExpression::LeafNode>(multiInterval));
+		context.stackNodes.push_back(RegularExpression::makeShared<RegularExpression::LeafNode>(multiInterval));
 	}
 | class_char
     {
-		auto set = popSet<RegularExpression::Set>();
-		stackNodes.push_back(std::make_shared<RegularExpression::LeafNode>(set));
+		auto set = popSet<RegularExpression::Set>(context);
+		context.stackNodes.push_back(RegularExpression::makeShared<RegularExpression::LeafNode>(set));
 	}
 | '.'
     {
-        auto except = std::make_shared<RegularExpression::ExceptNode>();
+        auto except = RegularExpression::makeShared<RegularExpression::ExceptNode>();
         except->addException(RegularExpression::Interval('\n', '\n'));
-		stackNodes.push_back(except);
+		context.stackNodes.push_back(except);
     }
+| unicode_class
+	{
+		context.stackNodes.push_back(createUnicodeClass(context, false));
+	}
 | '[' l_charset ']'
     {
-		auto set = popSet<RegularExpression::MultiInterval>();
-        auto range = std::make_shared<RegularExpression::RangeNode>();
-        for (const auto& interval : set->getIntervals())
-            range->addInterval(interval);
-		stackNodes.push_back(range);
+		auto set = popSet<RegularExpression::MultiInterval>(context);
+		if (!context.codePoints.empty())
+		{
+			// a class with Unicode members is a class of code points: its characters are the code points U+0000 to U+00FF
+			for (const auto& interval : set->getIntervals())
+				addCodePoints(context, interval.getMin(), interval.getMax());
+			context.stackNodes.push_back(createUnicodeClass(context, false));
+		}
+		else
+		{
+			auto range = RegularExpression::makeShared<RegularExpression::RangeNode>();
+			for (const auto& interval : set->getIntervals())
+				range->addInterval(interval);
+			context.stackNodes.push_back(range);
+		}
     }
 | '[' '^' l_charset ']'
     {
-		auto set = popSet<RegularExpression::MultiInterval>();
-        auto range = std::make_shared<RegularExpression::ExceptNode>();
-        for (const auto& interval : set->getIntervals())
-            range->addException(interval);
-		stackNodes.push_back(range);
+		auto set = popSet<RegularExpression::MultiInterval>(context);
+		if (!context.codePoints.empty())
+		{
+			for (const auto& interval : set->getIntervals())
+				addCodePoints(context, interval.getMin(), interval.getMax());
+			context.stackNodes.push_back(createUnicodeClass(context, true));
+		}
+		else
+		{
+			auto range = RegularExpression::makeShared<RegularExpression::ExceptNode>();
+			for (const auto& interval : set->getIntervals())
+				range->addException(interval);
+			context.stackNodes.push_back(range);
+		}
     }
 | reg_exp '?'
     {
-		auto node = popNode();
-        auto or_ = std::make_shared<RegularExpression::OrNode>();
+		auto node = popNode(context);
+        auto or_ = RegularExpression::makeShared<RegularExpression::OrNode>();
         if (node)
             or_->addChild(node);
-        or_->addChild(std::make_shared<RegularExpression::EmptyNode>());
-		stackNodes.push_back(or_);
+        or_->addChild(RegularExpression::makeShared<RegularExpression::EmptyNode>());
+		context.stackNodes.push_back(or_);
     }
 | reg_exp '*'
 	{
-		auto node = popNode();
-		stackNodes.push_back(std::make_shared<RegularExpression::StarNode>(node));
+		auto node = popNode(context);
+		context.stackNodes.push_back(RegularExpression::makeShared<RegularExpression::StarNode>(node));
 	}
 | reg_exp '+'
 	{
-		auto node = popNode();
-		stackNodes.push_back(std::make_unique<RegularExpression::PlusNode>(node));
+		auto node = popNode(context);
+		context.stackNodes.push_back(RegularExpression::makeShared<RegularExpression::PlusNode>(node));
 	}
 | reg_exp '|' reg_exp
     {
-		auto node2 = popNode();
-		auto node1 = popNode();
+		auto node2 = popNode(context);
+		auto node1 = popNode(context);
         auto or_ = std::dynamic_pointer_cast<RegularExpression::OrNode>(node1);
         if (!or_)
         {
-            or_ = std::make_shared<RegularExpression::OrNode>();
+            or_ = RegularExpression::makeShared<RegularExpression::OrNode>();
             or_->addChild(node1);
         }
         or_->addChild(node2);
-		stackNodes.push_back(or_);
+		context.stackNodes.push_back(or_);
     }
 | '(' l_reg_exp ')'
-| _MACRO_ 									{ stackNodes.push_back(findMacro(macroName)); }
-| reg_exp '{' integer             '}' 		{ auto node = popNode(); stackNodes.push_back(createRepeat(node, $3)); }
-| reg_exp '{' integer ',' integer '}' 		{ auto node = popNode(); stackNodes.push_back(createRangeMinMax(node, $3, $5)); }
-| reg_exp '{' integer ','		  '}' 		{ auto node = popNode(); stackNodes.push_back(createRangeMin(node, $3)); }
+| _MACRO_ 									{ context.stackNodes.push_back(findMacro(context, context.macroName)); }
+| reg_exp '{' integer             '}' 		{ auto node = popNode(context); context.stackNodes.push_back(createRepeat(context, node, $3)); }
+| reg_exp '{' integer ',' integer '}' 		{ auto node = popNode(context); context.stackNodes.push_back(createRangeMinMax(context, node, $3, $5)); }
+| reg_exp '{' integer ','		  '}' 		{ auto node = popNode(context); context.stackNodes.push_back(createRangeMin(context, node, $3)); }
 ;
 
 hexa_digit:
@@ -206,27 +240,34 @@ char_literal:
 ;
 
 single_char:
-  char_literal						{ stackSet.push_back(std::make_shared<RegularExpression::Interval>($1,$1)); }
-| _PREFIX_ hexa_digit hexa_digit 	{ auto val = hexaDigit2int($2) * 16 + hexaDigit2int($3); stackSet.push_back(std::make_shared<RegularExpression::Interval>(val, val)); }
+  char_literal						{ context.stackSet.push_back(RegularExpression::makeShared<RegularExpression::Interval>($1,$1)); }
+| _PREFIX_ hexa_digit hexa_digit 	{ auto val = hexaDigit2int($2) * 16 + hexaDigit2int($3); context.stackSet.push_back(RegularExpression::makeShared<RegularExpression::Interval>(val, val)); }
 ;
 
 class_char:
-  _NOT_SPACE_			{ stackSet.push_back(RegularExpression::Set::getSpaceSet()->reverse()); }
-| _NOT_DIGIT_			{ stackSet.push_back(RegularExpression::Set::getDigitSet()->reverse()); }
-| _WORD_  				{ stackSet.push_back(RegularExpression::Set::getWordSet()); }
-| _NOT_WORD_			{ stackSet.push_back(RegularExpression::Set::getWordSet()->reverse()); }
-| _ALPHA_ 				{ stackSet.push_back(RegularExpression::Set::getAlphabeticSet()); }
-| _ALNUM_ 				{ stackSet.push_back(RegularExpression::Set::getAlphanumericSet()); }
-| _LOWER_ 				{ stackSet.push_back(RegularExpression::Set::getLowerSet()); }
-| _UPPER_ 				{ stackSet.push_back(RegularExpression::Set::getUpperSet()); }
-| _DIGIT_ 				{ stackSet.push_back(RegularExpression::Set::getDigitSet()); }
-| _XDIGIT_ 				{ stackSet.push_back(RegularExpression::Set::getHexaDigitSet()); }
-| _SPACE_ 				{ stackSet.push_back(RegularExpression::Set::getSpaceSet()); }
-| _BLANK_ 				{ stackSet.push_back(RegularExpression::Set::getBlankSet()); }
-| _CNTRL_ 				{ stackSet.push_back(RegularExpression::Set::getControlSet()); }
-| _PRINT_ 				{ stackSet.push_back(RegularExpression::Set::getPrintSet()); }
-| _GRAPH_ 				{ stackSet.push_back(RegularExpression::Set::getGraphSet()); }
-| _PUNCT_ 				{ stackSet.push_back(RegularExpression::Set::getPunctSet()); }
+  _NOT_SPACE_			{ context.stackSet.push_back(RegularExpression::Set::getSpaceSet()->reverse()); }
+| _NOT_DIGIT_			{ context.stackSet.push_back(RegularExpression::Set::getDigitSet()->reverse()); }
+| _WORD_  				{ context.stackSet.push_back(RegularExpression::Set::getWordSet()); }
+| _NOT_WORD_			{ context.stackSet.push_back(RegularExpression::Set::getWordSet()->reverse()); }
+| _ALPHA_ 				{ context.stackSet.push_back(RegularExpression::Set::getAlphabeticSet()); }
+| _ALNUM_ 				{ context.stackSet.push_back(RegularExpression::Set::getAlphanumericSet()); }
+| _LOWER_ 				{ context.stackSet.push_back(RegularExpression::Set::getLowerSet()); }
+| _UPPER_ 				{ context.stackSet.push_back(RegularExpression::Set::getUpperSet()); }
+| _DIGIT_ 				{ context.stackSet.push_back(RegularExpression::Set::getDigitSet()); }
+| _XDIGIT_ 				{ context.stackSet.push_back(RegularExpression::Set::getHexaDigitSet()); }
+| _SPACE_ 				{ context.stackSet.push_back(RegularExpression::Set::getSpaceSet()); }
+| _BLANK_ 				{ context.stackSet.push_back(RegularExpression::Set::getBlankSet()); }
+| _CNTRL_ 				{ context.stackSet.push_back(RegularExpression::Set::getControlSet()); }
+| _PRINT_ 				{ context.stackSet.push_back(RegularExpression::Set::getPrintSet()); }
+| _GRAPH_ 				{ context.stackSet.push_back(RegularExpression::Set::getGraphSet()); }
+| _PUNCT_ 				{ context.stackSet.push_back(RegularExpression::Set::getPunctSet()); }
+;
+
+// the code points are added to context.codePoints, until the class is complete
+unicode_class:
+  _CODE_POINT_			{ addCodePoints(context, $1, $1); }
+| _PROPERTY_ 			{ addProperty(context, context.propertyName, false); }
+| _NOT_PROPERTY_ 		{ addProperty(context, context.propertyName, true); }
 ;
 
 integer:
@@ -237,8 +278,8 @@ integer:
 l_charset :
   l_charset charset
 	{
-		auto set2 = popSet<RegularExpression::MultiInterval>();
-		auto set1 = std::dynamic_pointer_cast<RegularExpression::MultiInterval>(stackSet.back());
+		auto set2 = popSet<RegularExpression::MultiInterval>(context);
+		auto set1 = std::dynamic_pointer_cast<RegularExpression::MultiInterval>(context.stackSet.back());
 		set1->addInterval(set2->getIntervals());
 	}
 |           charset
@@ -247,37 +288,51 @@ l_charset :
 charset :
   single_char
     {
-		auto interval = popSet<RegularExpression::Interval>();
-		auto multiInterval = std::make_shared<RegularExpression::MultiInterval>();
+		auto interval = popSet<RegularExpression::Interval>(context);
+		auto multiInterval = RegularExpression::makeShared<RegularExpression::MultiInterval>();
 		multiInterval->addInterval(*interval.get());
-		stackSet.push_back(multiInterval);
+		context.stackSet.push_back(multiInterval);
 	}
 | class_char
+	{
+		// the predefined classes are shared: the set is copied since l_charset adds the next intervals to it
+		auto set = popSet<RegularExpression::Set>(context);
+		context.stackSet.push_back(set->clone());
+	}
 | single_char '-' single_char
 	{
-		auto set2 = popSet<RegularExpression::Interval>();
-		auto set1 = popSet<RegularExpression::Interval>();
-		auto multiInterval = std::make_shared<RegularExpression::MultiInterval>();
+		auto set2 = popSet<RegularExpression::Interval>(context);
+		auto set1 = popSet<RegularExpression::Interval>(context);
+		auto multiInterval = RegularExpression::makeShared<RegularExpression::MultiInterval>();
 		multiInterval->addInterval(RegularExpression::Interval(set1->getMin(), set2->getMin()));
-		stackSet.push_back(multiInterval);
+		context.stackSet.push_back(multiInterval);
+	}
+| unicode_class
+	{
+		context.stackSet.push_back(RegularExpression::makeShared<RegularExpression::MultiInterval>());
+	}
+| _CODE_POINT_ '-' _CODE_POINT_
+	{
+		addCodePoints(context, $1, $3);
+		context.stackSet.push_back(RegularExpression::makeShared<RegularExpression::MultiInterval>());
 	}
 ;
 
 %%
 
 template <typename T>
-std::shared_ptr<T> popSet()
+std::shared_ptr<T> popSet(ParsingContext& context)
 {
-	auto elem = std::dynamic_pointer_cast<T>(stackSet.back());
-	stackSet.pop_back();
+	auto elem = std::dynamic_pointer_cast<T>(context.stackSet.back());
+	context.stackSet.pop_back();
 	assert(elem);
 	return elem;
 }
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> popNode()
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> popNode(ParsingContext& context)
 {
-	auto elem = stackNodes.back();
-	stackNodes.pop_back();
+	auto elem = context.stackNodes.back();
+	context.stackNodes.pop_back();
 	//assert(elem);
 	return elem;
 }
@@ -293,10 +348,10 @@ int hexaDigit2int(char h)
     return -1;
 }
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> findMacro(const std::string &name)
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> findMacro(ParsingContext& context, const std::string &name)
 {
-	auto iter = mapTree.find(name);
-	if (iter != mapTree.end())
+	auto iter = context.macros.find(name);
+	if (iter != context.macros.end())
 	{
 		return iter->second->clone();
 	}
@@ -305,85 +360,88 @@ std::shared_ptr<RegularExpression::BaseLexerTreeNode> findMacro(const std::strin
 		std::string msg = "Unknown macro identifier '";
 		msg += name;
 		msg += "'";
-		addParsingErrorMessage(msg);
+		addParsingErrorMessage(context, msg);
 		return nullptr;
 	}
 }
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMin(std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min)
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMin(ParsingContext& /*context*/, std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min)
 {
 	if (expReg)
 	{
 		if (min == 0)
 		{
-			return std::make_unique<RegularExpression::StarNode>(expReg);
+			return RegularExpression::makeShared<RegularExpression::StarNode>(expReg);
 		}
 		else if (min == 1)
 		{
-			return std::make_unique<RegularExpression::PlusNode>(expReg);
+			return RegularExpression::makeShared<RegularExpression::PlusNode>(expReg);
 		}
 		std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>  concatVector;
 		for (auto i = 0; i < min-1; i++)
 		{
 			concatVector.push_back(expReg->clone());
 		}
-		auto result = std::make_shared<RegularExpression::ConcatNode>();
-		result->addChild(std::make_shared<RegularExpression::ConcatNode>(std::move(concatVector)));
-		result->addChild(std::make_shared<RegularExpression::PlusNode>(expReg));
+		auto result = RegularExpression::makeShared<RegularExpression::ConcatNode>();
+		result->addChild(RegularExpression::makeShared<RegularExpression::ConcatNode>(std::move(concatVector)));
+		result->addChild(RegularExpression::makeShared<RegularExpression::PlusNode>(expReg));
 		return result;
 	}
 	return nullptr;
 }
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMinMax(std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min, int max)
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRangeMinMax(ParsingContext& context, std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int min, int max)
 {
 	assert(expReg);
 	if (expReg)
 	{
 		if (min > max)
 		{
-			addParsingErrorMessage("Maximum occurence count must be greater than the minimum count");
+			addParsingErrorMessage(context, "Maximum occurence count must be greater than the minimum count");
 		}
 		else if (max < 1)
 		{
-			addParsingErrorMessage("Maximum occurence count must be greater than 0");
+			addParsingErrorMessage(context, "Maximum occurence count must be greater than 0");
 		}
 		else
 		{
-			std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>  concatVector;
-			for (auto i = 0; i < min; i++)
+			// the optional occurences are nested, (x(x(x)?)?)?, so that the tree grows linearly with the maximum count
+			std::shared_ptr<RegularExpression::BaseLexerTreeNode> optional;
+			for (auto i = min; i < max; i++)
 			{
-				concatVector.push_back(expReg->clone());
+				auto occurence = (i == min) ? expReg : expReg->clone();
+				if (optional)
+				{
+					std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>  nested;
+					nested.push_back(std::move(occurence));
+					nested.push_back(std::move(optional));
+					occurence = RegularExpression::makeShared<RegularExpression::ConcatNode>(std::move(nested));
+				}
+				optional = RegularExpression::makeShared<RegularExpression::OptionNode>(std::move(occurence));
 			}
 
-			auto baseConcat = std::make_shared<RegularExpression::ConcatNode>(std::move(concatVector));
-			std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>  orVector;
-
-			orVector.push_back(std::make_shared<RegularExpression::EmptyNode>());
-			while (min != max)
+			std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>  concatVector;
+			for (auto i = 0; i < min; i++)
 			{
-				for (auto i = 0; i < max - min; i++)
-				{
-					concatVector.push_back(expReg->clone());
-				}
-				orVector.push_back(std::make_shared<RegularExpression::ConcatNode>(std::move(concatVector)));
-				min++;
+				concatVector.push_back(expReg->clone());
 			}
-			concatVector.push_back(std::move(baseConcat));
-			concatVector.push_back(std::make_unique<RegularExpression::OrNode>(std::move(orVector)));
-			return std::make_shared<RegularExpression::ConcatNode>(std::move(concatVector));
+			if (optional)
+				concatVector.push_back(std::move(optional));
+			if (concatVector.size() == 1)
+				return concatVector.front();
+			return RegularExpression::makeShared<RegularExpression::ConcatNode>(std::move(concatVector));
 		}
 	}
 	return nullptr;
 }
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRepeat(std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int count)
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRepeat(ParsingContext& context, std::shared_ptr<RegularExpression::BaseLexerTreeNode> expReg, int count)
 {
 	if (expReg)
 	{
 		if (count < 1)
 		{
-			addParsingErrorMessage("Invalid occurence count");
+			addParsingErrorMessage(context, "Invalid occurence count");
 		}
 		else if (count == 1)
 		{
@@ -399,62 +457,86 @@ std::shared_ptr<RegularExpression::BaseLexerTreeNode> createRepeat(std::shared_p
 				count--;
 			}
 			result.push_back(std::move(expReg));
-			return std::make_unique<RegularExpression::ConcatNode>(std::move(result));
+			return RegularExpression::makeShared<RegularExpression::ConcatNode>(std::move(result));
 		}
 	}
 	return nullptr;
 }
 
-void yyerror(const char*s)
+void addCodePoints(ParsingContext& context, int min, int max)
 {
-	std::string msg = "syntax error at row ";
-	msg += std::to_string(getPreviousLexerPosition());
-	addParsingErrorMessage(msg);
+	if ((min < 0) || (max > RegularExpression::CodePointSet::maxCodePoint) || (min > max))
+	{
+		addParsingErrorMessage(context, "Invalid code point or code point range");
+		return;
+	}
+	context.codePoints.addRange(min, max);
 }
 
-void addMacroTree(const std::string& name, std::shared_ptr<RegularExpression::BaseLexerTreeNode> tree)
+void addProperty(ParsingContext& context, const std::string& name, bool inverse)
 {
-    mapTree.emplace(name, tree);
+	auto property = RegularExpression::CodePointSet::getProperty(name);
+	if (!property)
+	{
+		addParsingErrorMessage(context, "Unknown Unicode property '" + name + "'");
+		return;
+	}
+	context.codePoints.addSet(inverse ? property->reverse() : *property);
+}
+
+// Tree of the UTF-8 sequences of the code points of the class, or of the other code points if 'inverse'
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> createUnicodeClass(ParsingContext& context, bool inverse)
+{
+	auto codePoints = inverse ? context.codePoints.reverse() : context.codePoints;
+	context.codePoints = RegularExpression::CodePointSet();
+	auto tree = codePoints.toUtf8Tree();
+	if (!tree && context.errorMessages.empty())
+		addParsingErrorMessage(context, "Empty Unicode class");
+	return tree;
 }
 
-void addParsingErrorMessage(const std::string& msg)
+void yyerror(ParsingContext& context, yyscan_t /*scanner*/, const char* /*s*/)
 {
-	errorMessages.push_back(msg + postfixMsg);
+	std::string msg = "syntax error at row ";
+	msg += std::to_string(context.prevRowPosition);
+	addParsingErrorMessage(context, msg);
 }
 
-const std::vector<std::string>& getParsingErrorMessages()
+void addParsingErrorMessage(ParsingContext& context, const std::string& msg)
 {
-	return errorMessages;
+	context.errorMessages.push_back(msg + context.postfixMsg);
 }
 
 //////////////////////////////////////////////////
 // The section below is for parsing of strings
 
 typedef struct yy_buffer_state * YY_BUFFER_STATE;
-extern YY_BUFFER_STATE yy_scan_string(const char *);
+int yylex_init_extra(ParsingContext* context, yyscan_t* scanner);
+int yylex_destroy(yyscan_t scanner);
+YY_BUFFER_STATE yy_scan_string(const char *str, yyscan_t scanner);
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> parseString(const char *str, const std::string& postfixMsg_)
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> parseString(const char *str, const std::string& postfixMsg, const MacroTrees& macros, std::vector<std::string>& errorMessages)
 {
-	postfixMsg = postfixMsg_;
-	errorMessages.clear();
-    initLexer();
-	stackNodes.clear();
-	stackSet.clear();
-    yy_scan_string(str);
+	ParsingContext context(macros, postfixMsg);
+	yyscan_t scanner;
+	yylex_init_extra(&context, &scanner);
+    yy_scan_string(str, scanner);
 #if YYDEBUG
 	yydebug=1;
 	traceFile = fopen( TRACE_FILE_DEBUG, "a" );
 	fprintf(traceFile, "=+=+=+=+=+=+=+=+=+=+=+=+= START '%s' =+=+=+=+=+=+=+=+=+=+=+=+=" NEW_LINE, str);
 #endif
-    yyparse();
+    yyparse(context, scanner);
+    yylex_destroy(scanner);
 #if YYDEBUG
 	yydebug=0;
 	fprintf(traceFile, "=+=+=+=+=+=+=+=+=+=+=+=+= END =+=+=+=+=+=+=+=+=+=+=+=+=" NEW_LINE);
 	fclose( traceFile );
 #endif
-	if (stackNodes.size()==0)
+	errorMessages.insert(errorMessages.end(), context.errorMessages.begin(), context.errorMessages.end());
+	if (context.stackNodes.size()==0)
 		return nullptr;
-	auto node = popNode();
+	auto node = popNode(context);
 	//assert(stackNodes.empty());
 	//assert(stackSet.empty());
     return node;
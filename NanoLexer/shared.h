@@ -1,15 +1,36 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <map>
 #include <memory>
 #include "LexerTreeNode.h"
 
-std::shared_ptr<RegularExpression::BaseLexerTreeNode> parseString(const char* str, const std::string& postfixMsg_);
-void addMacroTree(const std::string& name, std::shared_ptr<RegularExpression::BaseLexerTreeNode> tree);
+// trees of the macros of a lexer generator, by name
+using MacroTrees = std::map<std::string, std::shared_ptr<RegularExpression::BaseLexerTreeNode>>;
 
-// share token _MACRO_ between lexer and parser
-extern std::string macroName;
+// State of the parsing of an expression, shared between the lexer and the parser. Both are reentrant and keep
+// their state there, so that several lexer generators can parse expressions at the same time in different threads.
+struct ParsingContext
+{
+	ParsingContext(const MacroTrees& macros_, const std::string& postfixMsg_) :macros{ macros_ }, postfixMsg{ postfixMsg_ } {}
 
-// error management
-const std::vector<std::string>& getParsingErrorMessages();
+	const MacroTrees&			macros;
+	std::string					postfixMsg;
+	std::vector<std::string>	errorMessages;
 
+	// parser stacks
+	std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>	stackNodes;
+	std::vector<std::shared_ptr<RegularExpression::Set>>				stackSet;
+	RegularExpression::CodePointSet										codePoints;		// Unicode part of the current class
+
+	// lexer state
+	int			rowPosition = 1;
+	int			prevRowPosition = 1;
+	bool		verbatim = false;
+	std::string	macroName;		// value of the token _MACRO_
+	std::string	propertyName;	// value of the tokens _PROPERTY_ and _NOT_PROPERTY_
+};
+
+// Parses the expression 'str'. Macros are looked up in 'macros'. Error messages (suffixed with 'postfixMsg') are added to 'errorMessages'.
+std::shared_ptr<RegularExpression::BaseLexerTreeNode> parseString(const char* str, const std::string& postfixMsg, const MacroTrees& macros, std::vector<std::string>& errorMessages);
@@ -6,11 +6,22 @@
 #include <map>
 #include <set>
 
+namespace RegularExpression
+{
+	class BaseLexerTreeNode;
+	class NodeArena;
+	class LexerContext;
+	class LazyDfa;
+}
+
 namespace NanoLexer
 {
+	class Matcher;
+
 	// class LexerGenerator allows to define the model of a lexer.
 	// The generated lexers may contain several contexts, which allows a higher power of expression. 
 	// This feature is required to match C multiline comments and strings.
+	// Distinct instances do not share any state, they can be used at the same time in different threads.
 	class LexerGenerator
 	{
 	public:
@@ -32,6 +43,24 @@ namespace NanoLexer
 			// Set an action Pop.
 			Expression* setPopAction();
 
+			// Makes getNextToken() skip the matches of the expression (spaces, comments...): they are consumed in its loop
+			// and only the other lexemes are returned. Their match code and the default match code are still executed,
+			// e.g. to count the lines. Only for the expressions of the main context; can be combined with a push action.
+			Expression* setSkip();
+
+			// Makes the lexer compute the integer value of the matches of the expression while it reads them: each digit of
+			// 'base' (2 to 36, the letters after 9 in any case) consumed by the expression is accumulated, the other bytes
+			// (prefix letters, separators...) are ignored. getIntegerValue() of the generated lexer returns the value of the
+			// last lexeme of such an expression, modulo 2^64. Only for the expressions of the main context.
+			Expression* setIntegerValue(int base = 10);
+
+			// Makes the lexer hash the matches of the expression while it reads them, for getSymbolId() of the generated
+			// lexer: it interns the last lexeme of such an expression in a table of the lexer and returns its id, the same
+			// for the same text, numbered from 0 by first occurrence. The text of a symbol is copied only once, when it is
+			// new; getSymbolText() returns it. getSymbolId() returns (unsigned)-1 after a lexeme of another expression. Only for
+			// the expressions of the main context.
+			Expression* setInterned();
+
 			// Add statements in the generated lexer that will be called when a match if found for the expression.
 			// Overrides LexerGenerator::addDefaultOnMatch() for the present expression
 			Expression* addOnMatchCode(const std::string& code);
@@ -41,6 +70,9 @@ namespace NanoLexer
 			inline const std::string& getExpression() const { return expr; }
 			inline ActionOnMatch getAction() const { return action; }
 			inline const std::string& getPushedContext() const { return pushedContext; }
+			inline bool isSkipped() const { return skip; }
+			inline int getIntegerBase() const { return integerBase; }	// 0 without integer value
+			inline bool isInterned() const { return interned; }
 		private:
 			friend LexerGenerator;
 
@@ -52,6 +84,10 @@ namespace NanoLexer
 			std::string matchCode;
 			ActionOnMatch	action;	// default is none
 			std::string		pushedContext;	// valid only when action==ActionOnMatch::push
+			bool			skip = false;
+			int				integerBase = 0;
+			bool			interned = false;
+			std::shared_ptr<RegularExpression::BaseLexerTreeNode>	tree;	// result of the parsing of expr
 		};
 
 		LexerGenerator(const std::string& name, bool throwEarly=false);
@@ -78,11 +114,71 @@ namespace NanoLexer
 		// Generates the internal data structures of the lexer. Must be called before method generateFiles().
 		void generateLexer();
 
+		// Sets the maximum number of states of each context of the lexer (0, the default, for no limit). generateLexer()
+		// stops with an error as soon as a context exceeds it, instead of exhausting the memory on a state explosion.
+		void setMaxStateCount(int count);
+
+		// When the DFA of the main context exceeds the maximum number of states, generates instead a bit-parallel simulation
+		// of its position automaton: the positions reached are bits of 64-bit words, and the tables are quadratic in the
+		// number of positions (256 at most) whatever the expressions. The main context must not push contexts.
+		void setPositionAutomatonFallback(bool fallback);
+
+		// Makes the generated lexer count the transitions taken by its states, in order to profile it on a representative
+		// input. Its method writeProfile(out) writes these counts to a stream, as lines "context state transition count".
+		void setProfileInstrumentation(bool instrument);
+
+		// Sets a profile written by writeProfile() of an instrumented lexer generated from the same model. The generated code 
+		// then tests the transitions by decreasing frequency, places the most visited states first and marks the transitions 
+		// never taken as unlikely (with [[unlikely]] when compiled as C++20). A line naming a context, a state or a transition
+		// the lexer does not have is an error: the profile comes from another model.
+		void setProfile(const std::string& profile);
+
+		// Makes each state of the generated lexer dispatch on the byte read with a single indirect jump through a table
+		// of labels ("computed goto"), when compiled by GCC or Clang. Other compilers, or NANOLEXER_COMPUTED_GOTO defined
+		// to 0 before including the lexer, use the portable switch and if.
+		void setComputedGoto(bool computedGoto);
+
+		// Makes the states of the generated lexer that loop on a few ranges of bytes (identifiers, spaces, bodies of comments
+		// or strings) consume the run of these bytes by blocks of 64, classified with SSE2 into a bitmask whose trailing ones
+		// give the length of the run. The lexer then reads its input ahead by blocks. Compilers without SSE2, or
+		// NANOLEXER_SIMD defined to 0 before including the lexer, read the bytes one by one.
+		void setRunScan(bool runScan);
+
+		// Adds the method findNextToken() to the generated lexer, which searches the input for the expressions of the main
+		// context instead of tokenizing it from its start: it returns the leftmost match (the longest one at its offset, see
+		// getMatchOffset()) and skips the text in between. The attempts from all the offsets run together on tables of the
+		// DFA, so that a byte is read once per state rather than once per attempt. The bytes that cannot start a match are
+		// skipped with memchr when the expressions start with the same byte, else by blocks of 64 bytes classified with SSE2
+		// (see setRunScan()).
+		void setScanMode(bool scanMode);
+
+		// Makes the generated lexer keep its match and the input read ahead in arrays of 'maxMatchLength' bytes inside the
+		// lexer instead of strings (0, the default, for strings), so that it never allocates and can be created on the
+		// stack. getMatchString() then returns a std::string_view. The lexer reads at most one byte after the longest match
+		// allowed: when it would need more, to find a longer match or to backtrack from it, or for a longer run of unknown
+		// bytes, it returns the lexeme overflow_ and consumes the first 'maxMatchLength' bytes. Cannot be combined with
+		// setRunScan(), setScanMode() and Expression::setInterned(), which read ahead by blocks or keep a table on the heap.
+		// The line index (NANOLEXER_LINE_INDEX) still allocates: it keeps the offset of each new line in a std::vector.
+		void setFixedCapacity(int maxMatchLength);
+
+		// Returns a matcher of the expressions of the main context, which runs them without generating a lexer (see class
+		// Matcher). Its DFA is computed lazily, and at most 'maxStateCount' of its states are kept. The generator must
+		// outlive the matcher, which throws a NanoLexerException for a model with errors.
+		std::unique_ptr<Matcher> createMatcher(int maxStateCount);
+
 		// Generates the source files of the lexer. 
 		// 'language' must be a subdirectory of directory 'lexer_sk'.
 		// 'outputPath' is a relative path to the current path that will contain the generated sources.
+		// The generated files embed a hash of the model of the lexer and of the skeleton files (see isUpToDate()).
+		// A file whose content did not change is not rewritten.
 		void generateFiles(const std::string& language, const std::string& outputPath);
 
+		// Returns true when the files found in 'outputPath' were generated from the same model of lexer (expressions, 
+		// macros, contexts, code snippets) and the same skeleton files. In that case calling generateLexer() and 
+		// generateFiles() is useless and can be skipped, which leaves the files (and their timestamps) untouched.
+		// Must be called once the model is complete, before generateLexer().
+		bool isUpToDate(const std::string& language, const std::string& outputPath);
+
 		std::string getDebugString();
 
 		// Add public menbers in the generated lexer class.
@@ -115,6 +211,8 @@ namespace NanoLexer
 		void addErrorMessage(const std::string& msg);
 		void addErrorMessages(const std::vector<std::string>& msgs);
 	private:
+		// memory of the trees, declared first so that it is released after them
+		std::unique_ptr<RegularExpression::NodeArena>	arena;
 		int								lexemeId;
 		bool							throwEarly;
 		std::vector<std::string>		errorMessages;
@@ -122,6 +220,14 @@ namespace NanoLexer
 		std::string debugString;
 		std::string lexerName;
 		int lexemeCount;
+		int maxStateCount = 0;
+		bool positionAutomatonFallback = false;
+		bool profileInstrumentation = false;
+		std::string profile;
+		bool computedGoto = false;
+		bool runScan = false;
+		bool scanMode = false;
+		int fixedCapacity = 0;
 
 		std::string publicMembers;
 		std::string protectedMembers;
@@ -136,12 +242,40 @@ namespace NanoLexer
 		std::vector<std::tuple<std::string, std::vector<std::pair<std::string, Expression>>>>	contextsData;
 		std::tuple<std::string, std::vector<std::pair<std::string, Expression>>>				currentContext;
 		std::map<std::string, Expression>														macros;
+		std::map<std::string, std::shared_ptr<RegularExpression::BaseLexerTreeNode>>			macroTrees;
 
 		Expression* add2CurrentContext(const std::string& name, const std::string& expr);
 
+		std::string computeModelHash(const std::string& skeletons) const;
+
 		void closeContext();
 	};
 
+	// class Matcher finds the matches of the expressions of the main context of a model in a text, with the DFA of these
+	// expressions built on demand: only the states reached by the texts matched are computed, and they are kept in a
+	// cache which is flushed when full. Neither the contexts nor the actions of the model are run.
+	class Matcher
+	{
+	public:
+		~Matcher();
+
+		// Returns the id of the lexeme of the longest match at the start of [begin, end), the value of the enum Lexeme of
+		// the lexer generated from the same model (the first expression declared when several expressions match it), and
+		// sets 'length' to its length. Returns -1 (Lexeme::unknown_) when nothing matches.
+		int longestMatch(const char* begin, const char* end, std::size_t& length);
+
+		// Number of states in the cache, and number of times the cache was flushed
+		std::size_t getStateCount() const;
+		std::size_t getFlushCount() const;
+	private:
+		friend LexerGenerator;
+
+		Matcher(std::vector<std::shared_ptr<RegularExpression::BaseLexerTreeNode>>&& trees, int maxStateCount);
+
+		std::unique_ptr<RegularExpression::LexerContext>	context;
+		std::unique_ptr<RegularExpression::LazyDfa>			dfa;
+	};
+
 	// An exception NanoLexerException may be raised by LexerGenerator::generateLexer() for any inconsistency found in the model of the lexer.
 	class NanoLexerException
 	{
@@ -3,10 +3,32 @@
 // © Pierre Picard 2021
 // source : $(LexerName)Lexer.h
 // generated from skeleton file Lexer.h
+// model hash : $(ModelHash)
 //
 #ifndef $(LexerName)LEXER
 #define $(LexerName)LEXER
 #include <string>
+$(Includes)
+#ifdef NANOLEXER_LINE_INDEX
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+// SSE2 is always available on x86-64, and enabled by -msse2 on x86
+#ifndef NANOLEXER_SIMD
+#if defined(__SSE2__) || defined(_M_X64)
+#define NANOLEXER_SIMD 1
+#else
+#define NANOLEXER_SIMD 0
+#endif
+#endif
+#if NANOLEXER_SIMD
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#endif
 
 namespace NanoLexer
 {
@@ -16,10 +38,11 @@ namespace NanoLexer
     {
     public:
         using Traits = typename Stream::traits_type;
+$(BufferType)
 
 		enum class Lexeme
 		{
-			unknown_ = -1,
+$(ErrorLexemes)			unknown_ = -1,
 			eof_,
 			$(LexemeNames)
 		};
@@ -29,39 +52,98 @@ namespace NanoLexer
 		{
             accepted = Lexeme::unknown_;
 			nbRead = 0;
-			nbReadAfterAccept = 0;
+			acceptedLength = 0;
+			bufPos = 0;
+			matchOffset = 0;
+			nextOffset = 0;
 $(OnCreate)
 		}
 
-		inline const std::string& getMatchString() const {return matchString;}
+		inline $(MatchStringType) getMatchString() const {return matchString;}
 		inline Lexeme getAcceptedLexeme() const {return accepted;}
 		inline int getMatchLength() const {return nbRead;}
+		inline std::size_t getMatchOffset() const {return matchOffset;}	// offset of the match in the input, in bytes
+
+#ifdef NANOLEXER_STATS
+		// Statistics of the lexer, recorded only when NANOLEXER_STATS is defined before including the lexer
+		struct Stats
+		{
+			static constexpr int maxBacktrack = 16;
+			static constexpr int lexemeCount = $(LexemeCount);	// including unknown_, eof_ and the lexemes of the errors (overflow_)
+			static constexpr int lexemeOffset = $(LexemeOffset);	// index of eof_, the lexemes below it coming first
+
+			unsigned long long counts[lexemeCount] = {};		// by lexeme, at index (int)lexeme + lexemeOffset
+			unsigned long long bytes[lexemeCount] = {};			// characters matched, by lexeme, at index (int)lexeme + lexemeOffset
+			unsigned long long backtracks[maxBacktrack + 1] = {};	// by number of characters read after the last accept (maxBacktrack and more in the last one)
+			unsigned long long pushCount = 0;	// contexts pushed
+			unsigned long long popCount = 0;	// contexts popped
+
+			inline unsigned long long getCount(Lexeme l) const {return counts[(int)l + lexemeOffset];}
+			inline unsigned long long getBytes(Lexeme l) const {return bytes[(int)l + lexemeOffset];}
+		};
+
+		inline const Stats& getStats() const {return stats;}
+		inline void resetStats() {stats = Stats();}
+#endif
+
+#ifdef NANOLEXER_LINE_INDEX
+		// Line and column (from 1, the column in bytes) of an offset of the input consumed, e.g. getMatchOffset(), only when
+		// NANOLEXER_LINE_INDEX is defined before including the lexer. The states do not track lines: the lexer keeps the
+		// offsets of the new lines, found in blocks of the input consumed, see LineIndex.
+		std::pair<std::size_t, std::size_t> lineColumnOf(std::size_t offset) const
+		{
+			offset = std::min(offset, nextOffset);
+			if (offset >= lineIndex.blockOffset)
+				lineIndex.scan();
+			const auto& newLines = lineIndex.newLines;
+			std::size_t line = std::lower_bound(newLines.begin(), newLines.end(), offset) - newLines.begin();
+			std::size_t lineStart = line ? newLines[line - 1] + 1 : 0;
+			return { line + 1, offset - lineStart + 1 };
+		}
+#endif
 
         Lexeme getNextToken()
         {
 $(OnStartNextToken)
-            matchString = "";
+            matchString.clear();
             accepted = Lexeme::unknown_;
+            matchOffset = nextOffset;
             while (true)
             {
                 nbRead = 0;
-                nbReadAfterAccept = 0;
+                acceptedLength = 0;
                 main_context();
-                if (accepted != Lexeme::unknown_)
+$(CheckOverflow)                if (accepted != Lexeme::unknown_)
                 {
-                    while (nbReadAfterAccept)
-                    {
-                        unget();
-                    }
+#ifdef NANOLEXER_STATS
+                    stats.backtracks[(nbRead - acceptedLength < Stats::maxBacktrack) ? nbRead - acceptedLength : Stats::maxBacktrack]++;
+#endif
+                    unget(nbRead - acceptedLength);
                     if (matchString.size() > nbRead)
                     {
-                        while (nbRead)
-                        {
-                            unget();
-                        }
+                        unget(nbRead);
+#ifdef NANOLEXER_STATS
+                        stats.counts[(int)Lexeme::unknown_ + Stats::lexemeOffset]++;
+                        stats.bytes[(int)Lexeme::unknown_ + Stats::lexemeOffset] += matchString.size();
+#endif
+                        endMatch();
                         return Lexeme::unknown_;
                     }
+#ifdef NANOLEXER_STATS
+                    stats.counts[(int)accepted + Stats::lexemeOffset]++;
+                    stats.bytes[(int)accepted + Stats::lexemeOffset] += nbRead;
+#endif
 					onMatch();
+                    if (isSkipped(accepted))
+                    {
+                        // consumed here: the next lexeme is matched without returning
+                        endMatch();
+                        matchOffset = nextOffset;
+                        matchString.clear();
+                        accepted = Lexeme::unknown_;
+                        continue;
+                    }
+                    endMatch();
                     return accepted;
                 }
             }
@@ -69,11 +151,15 @@ $(OnStartNextToken)
 		
         int get()
         {
-            int c;
-            if (buf.size())
+$(CheckCapacity)            int c;
+            if (bufPos < buf.size())
             {
-                c = buf.back();
-                buf.pop_back();
+                c = Traits::to_int_type(buf[bufPos++]);	// not sign extended: the bytes above 0x7F index the tables of the generated code
+                if (bufPos == buf.size())
+                {
+                    buf.clear();
+                    bufPos = 0;
+                }
             }
             else
             {
@@ -83,17 +169,23 @@ $(OnStartNextToken)
             {
                 matchString += c;
                 nbRead++;
-                nbReadAfterAccept++;
             }
             return c;
         }
         
-        void unget()
+        inline void unget() {unget(1);}
+
+        // puts back the last 'count' bytes read in one block, over the bytes of buf already read when there is room
+        void unget(int count)
         {
-            nbRead--;
-            nbReadAfterAccept--;
-            buf.push_back(matchString.back());
-            matchString.pop_back();
+            if (count <= 0)
+                return;
+            nbRead -= count;
+            auto first = matchString.size() - count;
+            auto start = (bufPos >= (std::size_t)count) ? bufPos - count : 0;
+            buf.replace(start, bufPos - start, matchString.data() + first, count);
+            bufPos = start;
+            matchString.resize(first);
         }
 		
 		const char* getLexemeName(Lexeme l)
@@ -127,10 +219,79 @@ $(ProtectedMembers)
 $(PrivateMembers)
 
 $(LexerContextsMethods)
-        std::string     buf;
-        int             nbReadAfterAccept;
+#ifdef NANOLEXER_STATS
+        Stats           stats;
+#endif
+        Buffer          buf;                // input read ahead or put back, from bufPos
+        std::size_t     bufPos;
+        int             acceptedLength;     // nbRead when the accepted lexeme was matched
+        std::size_t     matchOffset;
+        std::size_t     nextOffset;         // offset of the input following the last match
+#ifdef NANOLEXER_LINE_INDEX
+        // The matches are only copied to a block of 4 KiB. The block is scanned for new lines, 16 bytes at a time with
+        // SSE2, when it is full or when a line is asked for, and is then reused: only the offsets of the new lines are kept.
+        struct LineIndex
+        {
+            std::vector<std::size_t>    newLines;           // offsets of the new lines of the blocks scanned
+            std::size_t                 blockOffset = 0;    // offset of the block in the input
+            std::size_t                 blockSize = 0;
+            char                        block[4096];
+
+            // adds the bytes [begin, begin + length) found at 'offset' in the input
+            void add(const char* begin, std::size_t length, std::size_t offset)
+            {
+                if (offset != blockOffset + blockSize)
+                {
+                    scan();
+                    blockOffset = offset;
+                }
+                while (length)
+                {
+                    if (blockSize == sizeof(block))
+                        scan();
+                    auto count = std::min(length, sizeof(block) - blockSize);
+                    std::memcpy(block + blockSize, begin, count);
+                    blockSize += count;
+                    begin += count;
+                    length -= count;
+                }
+            }
+
+            // indexes the new lines of the block, which is then empty
+            void scan()
+            {
+                std::size_t i = 0;
+#if NANOLEXER_SIMD
+                const auto newLine = _mm_set1_epi8('\n');
+                for (; i + 16 <= blockSize; i += 16)
+                {
+                    auto mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i)), newLine));
+                    while (mask)
+                    {
+#ifdef _MSC_VER
+                        unsigned long bit;
+                        _BitScanForward(&bit, mask);
+#else
+                        auto bit = __builtin_ctz(mask);
+#endif
+                        newLines.push_back(blockOffset + i + bit);
+                        mask &= mask - 1;
+                    }
+                }
+#endif
+                for (; i < blockSize; i++)
+                {
+                    if (block[i] == '\n')
+                        newLines.push_back(blockOffset + i);
+                }
+                blockOffset += blockSize;
+                blockSize = 0;
+            }
+        };
+        mutable LineIndex   lineIndex;          // scanned by lineColumnOf()
+#endif
         Stream&         inputStream;
-        std::string     matchString;
+        Buffer          matchString;
         Lexeme          accepted;
         int             nbRead;
 		
@@ -142,10 +303,60 @@ $(OnMatch)
 			}
 		}
         
+        // lexemes of the expressions set to be skipped (Expression::setSkip())
+        static inline bool isSkipped(Lexeme l)
+        {
+            switch (l)
+            {
+                $(SkippedCases)
+                default: return false;
+            }
+        }
+
         void accept(Lexeme l)
         {
             accepted = l;
-            nbReadAfterAccept = 0;
+            acceptedLength = nbRead;
+            acceptValue(l);
+        }
+
+        // keeps the values computed for an accepted lexeme (Expression::setIntegerValue(), setInterned()), whose bytes
+        // may be followed by bytes read for a longer match
+        inline void acceptValue(Lexeme l)
+        {
+            switch (l)
+            {
+                $(AcceptedValues)
+                default: break;
+            }
+        }
+
+        // the match is consumed: the next one follows it
+        inline void endMatch()
+        {
+#ifdef NANOLEXER_LINE_INDEX
+            lineIndex.add(matchString.data(), matchString.size(), matchOffset);
+#endif
+            nextOffset = matchOffset + matchString.size();
+        }
+
+        // accepts the lexeme of a state left on the last character read
+        void acceptBeforeLast(Lexeme l)
+        {
+            accepted = l;
+            acceptedLength = nbRead - 1;
+            acceptValue(l);
+        }
+
+        // called with the result of each push of a context, which is true when the context was popped
+        inline bool onContextReturn(bool popped)
+        {
+#ifdef NANOLEXER_STATS
+            stats.pushCount++;
+            if (popped)
+                stats.popCount++;
+#endif
+            return popped;
         }
     };
 }
@@ -5,6 +5,7 @@ void genArithmeticExpressionLexer()
     try
     {
         LexerGenerator lexGen("Arithmetic");
+        lexGen.setComputedGoto(true);             // one indirect jump per character with GCC and Clang
 
         lexGen.addMacro("[0-9]", "Digit");
         lexGen.addMacro("[1-9]", "NonNulDigit");
@@ -21,8 +22,11 @@ void genArithmeticExpressionLexer()
         lexGen.addVerbatimExpression(")", "close_parenthesis");
         lexGen.addExpression("[ \t]+", "whitespace");
 
-        lexGen.generateLexer();
-        lexGen.generateFiles("cpp", outputPath);
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
     }
     catch (const NanoLexerException& e)
     {
@@ -5,6 +5,7 @@ void genCMultilineCommentLexer()
     try
     {
         LexerGenerator lexGen("Comments");
+        lexGen.setComputedGoto(true);             // one indirect jump per character with GCC and Clang
 
         auto actionOnNewLine = "line++; row = 1;";
         auto actionOnAllOtherLexeme = "row += getMatchLength()-nbCharToSubstract;";
@@ -32,8 +33,11 @@ void genCMultilineCommentLexer()
         lexGen.addExpression("\\*\\/")              // match the closing pattern of the comment ('*/') => pop the context and return to the main one
             ->setPopAction();
 
-        lexGen.generateLexer();
-        lexGen.generateFiles("cpp", outputPath);
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
     }
     catch (const NanoLexerException& e)
     {
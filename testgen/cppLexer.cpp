@@ -5,6 +5,7 @@ void genCppLexer()
     try
     {
         LexerGenerator lexGen("Cpp");
+        lexGen.setComputedGoto(true);             // one indirect jump per character with GCC and Clang
 
         // keywords
         std::vector<std::string> keywords = { "alignas", "continue", "friend", "register", "true", "alignof", "decltype", "goto", "reinterpret_cast", "try", "asm", "default", "if", "return", "type"
@@ -44,8 +45,11 @@ void genCppLexer()
         lexGen.addExpression("\\*[^\\/]");
         lexGen.addExpression("\\*\\/")->setPopAction();
 
-        lexGen.generateLexer();
-        lexGen.generateFiles("cpp", outputPath);
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
     }
     catch (const NanoLexerException& e)
     {
@@ -0,0 +1,37 @@
+#include "lexgen.h"
+
+void genFixedLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Fixed");
+
+        // the match and the input read ahead are kept in the lexer, 16 bytes at most
+        lexGen.addExpression("[a-z]+", "id");
+        lexGen.addExpression("[0-9]+", "integer");
+        lexGen.addExpression("[0-9]+\\.[0-9]+", "real");
+        lexGen.addExpression(" +", "spaces")
+            ->setSkip();
+        // the whole comment is a single match
+        lexGen.addExpression("\\(", "comment")
+            ->setPushContext("Comment");
+
+        lexGen.newContext("Comment");
+        lexGen.addExpression("[^\\)]+");
+        lexGen.addExpression("\\)")
+            ->setPopAction();
+        lexGen.setFixedCapacity(16);
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
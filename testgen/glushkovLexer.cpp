@@ -0,0 +1,31 @@
+#include "lexgen.h"
+
+void genGlushkovLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Glushkov");
+
+        // the DFA of the first expression has 2^11 states: the lexer simulates the position automaton instead
+        lexGen.addExpression("(a|b)*a(a|b){10}", "tail");
+        lexGen.addExpression("[a-z]+", "word");
+        lexGen.addExpression(" +", "spaces")
+            ->setSkip();
+        lexGen.setMaxStateCount(100);
+        lexGen.setPositionAutomatonFallback(true);
+        lexGen.addPublicMembers("int failureCount = 0;");
+        lexGen.addOnCurrentContextFailure("failureCount++;");
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
@@ -11,5 +11,16 @@ void genSimpleLexer1();
 void genArithmeticExpressionLexer();
 void genCppLexer();
 void genCMultilineCommentLexer();
+void genProfiledLexers();
+void genStatsLexer();
+void genRangesLexer();
+void genUnicodeLexer();
+void genSkipLexer();
+void genLinesLexer();
+void genScanLexer();
+void genGlushkovLexer();
+void genNumbersLexer();
+void genSymbolsLexer();
+void genFixedLexer();
 
 #endif
@@ -0,0 +1,27 @@
+#include "lexgen.h"
+
+void genLinesLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Lines");
+
+        // no position tracking on match: the lines are computed on demand (see lineColumnOf())
+        lexGen.addExpression("[a-z]+", "id");
+        lexGen.addExpression("[0-9]+", "number");
+        lexGen.addExpression("[ \t\r\n]+", "spaces")
+            ->setSkip();
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
@@ -0,0 +1,41 @@
+#include "lexgen.h"
+
+void genNumbersLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Numbers");
+
+        // the values are computed while the digits are read, not from the match string
+        lexGen.addExpression("0x[0-9a-fA-F]+", "hexadecimal")
+            ->setIntegerValue(16);
+        lexGen.addExpression("0b[01]+", "binary")
+            ->setIntegerValue(2);
+        lexGen.addExpression("[0-9]+", "decimal")
+            ->setIntegerValue();
+        // the digits of a macro are those of its copy in the expression
+        lexGen.addMacro("[0-7]", "OctalDigit");
+        lexGen.addExpression("&o{OctalDigit}+", "octal")
+            ->setIntegerValue(8);
+        lexGen.addExpression("[0-9]+(_[0-9]+)+", "grouped")
+            ->setIntegerValue();
+        lexGen.addExpression("[0-9]+\\.[0-9]+", "real");
+        lexGen.addExpression("[a-z][a-z0-9]*", "id");
+        lexGen.addExpression(" +", "spaces")
+            ->setSkip();
+        // the runs of digits that are accumulated are not skipped by blocks
+        lexGen.setRunScan(true);
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
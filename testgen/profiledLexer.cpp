@@ -0,0 +1,64 @@
+#include "lexgen.h"
+
+namespace
+{
+    void defineModel(LexerGenerator& lexGen)
+    {
+        lexGen.addExpression("class", "class");
+        lexGen.addExpression("[a-zA-Z_][a-zA-Z0-9_]*", "id");
+        lexGen.addExpression("[0-9]+(\\.[0-9]+)?", "number");
+        lexGen.addVerbatimExpression(".", "dot");
+        lexGen.addExpression("[ \t]+", "whitespace");
+        lexGen.addExpression("\\n|(\\r\\n)", "new_line");
+    }
+
+    void generate(LexerGenerator& lexGen)
+    {
+        try
+        {
+            if (!lexGen.isUpToDate("cpp", outputPath))
+            {
+                lexGen.generateLexer();
+                lexGen.generateFiles("cpp", outputPath);
+            }
+        }
+        catch (const NanoLexerException& e)
+        {
+            for (const auto& msg : e.getMessages())
+                std::cout << msg << std::endl;
+            exit(1);
+        }
+    }
+}
+
+// Generates the same lexer twice: instrumented to write its profile, and laid out from such a profile
+void genProfiledLexers()
+{
+    LexerGenerator profiledGen("Profiled");
+    defineModel(profiledGen);
+    profiledGen.setProfileInstrumentation(true);
+    profiledGen.setComputedGoto(true);
+    generate(profiledGen);
+
+    LexerGenerator guidedGen("Guided");
+    defineModel(guidedGen);
+    // written by the lexer 'Profiled' on lines "object.member.field  value.x\tclass c2 12.5 7"
+    guidedGen.setProfile(R"(main_context 0 1 20
+main_context 0 2 60
+main_context 0 3 40
+main_context 0 4 100
+main_context 0 5 40
+main_context 0 6 100
+main_context 4 0 20
+main_context 4 1 20
+main_context 5 0 360
+main_context 6 0 20
+main_context 6 1 20
+main_context 7 0 20
+main_context 8 0 20
+main_context 9 0 20
+main_context 10 0 20
+main_context 12 0 20
+)");
+    generate(guidedGen);
+}
@@ -0,0 +1,28 @@
+#include "lexgen.h"
+
+void genRangesLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Ranges");
+
+        lexGen.addExpression("[aeiouAEIOU]+", "vowels");                            // many ranges: bitmap
+        lexGen.addExpression("[b-df-hj-np-tv-zB-DF-HJ-NP-TV-Z]+", "consonants");
+        lexGen.addExpression("[[:punct:]]+", "punct");                              // a few ranges: decision tree
+        lexGen.addExpression("[1-9][0-9]*", "digits");
+        lexGen.addExpression("[ \t\r\n]+", "spaces");
+        lexGen.addExpression("0x[^0-9A-Za-z_ ]+", "symbols");                       // decision tree on the reversed set
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
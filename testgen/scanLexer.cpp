@@ -0,0 +1,28 @@
+#include "lexgen.h"
+
+void genScanLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Scan");
+
+        // searched in logs with findNextToken(), the text in brackets being ignored
+        lexGen.addExpression("E[0-9][0-9][0-9][0-9]", "error");
+        lexGen.addExpression("[0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+", "ip");
+        lexGen.addExpression("\\[[^\\]]*\\]", "bracketed")
+            ->setSkip();
+        lexGen.setScanMode(true);
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
@@ -10,8 +10,11 @@ void genSimpleLexer1()
         lexGen.addExpression("[a-zA-Z0-9]+", "id");
         lexGen.addExpression("[ \t]+", "whitespace");
 
-        lexGen.generateLexer();
-        lexGen.generateFiles("cpp", outputPath);
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
     }
     catch (const NanoLexerException& e)
     {
@@ -0,0 +1,46 @@
+#include "lexgen.h"
+
+void genSkipLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Skip");
+
+        lexGen.addPrivateMembers("        int line;");
+        lexGen.addOnCreate("            line = 1;");
+        lexGen.addPublicMembers("        inline int getCurrentLine() const {return line;}");
+
+        lexGen.addExpression("[a-z]+", "id");
+        lexGen.addExpression("[0-9]+", "number");
+        // the spaces and the comments are not returned, the lines are still counted
+        lexGen.addExpression("[ \t]+", "whitespace")
+            ->setSkip();
+        lexGen.addExpression("\\n", "new_line")
+            ->setSkip()
+            ->addOnMatchCode("line++;");
+        lexGen.addExpression("/\\*", "comment")
+            ->setSkip()
+            ->setPushContext("Comment");
+
+        lexGen.newContext("Comment");
+        lexGen.addExpression("[^\\*]+");
+        lexGen.addExpression("\\*[^\\/]");
+        lexGen.addExpression("\\*\\/")
+            ->setPopAction();
+
+        // the runs of letters, digits, spaces and comment bodies are consumed by blocks
+        lexGen.setRunScan(true);
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
@@ -0,0 +1,33 @@
+#include "lexgen.h"
+
+void genStatsLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Stats");
+
+        lexGen.addExpression("[a-z]+", "id");
+        lexGen.addExpression("[0-9]+(\\.[0-9]+)?", "number");
+        lexGen.addExpression("[ \t]+", "whitespace");
+        lexGen.addExpression("/\\*", "comment")
+            ->setPushContext("Comment");
+
+        lexGen.newContext("Comment");
+        lexGen.addExpression("[^\\*]+");
+        lexGen.addExpression("\\*[^\\/]");
+        lexGen.addExpression("\\*\\/")
+            ->setPopAction();
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
@@ -0,0 +1,32 @@
+#include "lexgen.h"
+
+void genSymbolsLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Symbols");
+
+        // the identifiers are hashed while they are read, then interned without a second pass over their text
+        lexGen.addExpression("if", "if_keyword");
+        lexGen.addExpression("[a-zA-Z_][a-zA-Z0-9_]*", "id")
+            ->setInterned();
+        lexGen.addExpression("[0-9]+", "number");
+        lexGen.addExpression("[=;\\(\\)\\*\\+]", "punctuation");
+        lexGen.addExpression(" +", "spaces")
+            ->setSkip();
+        // the runs of identifier bytes that are hashed are not skipped by blocks
+        lexGen.setRunScan(true);
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
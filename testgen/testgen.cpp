@@ -8,4 +8,15 @@ int main()
     genArithmeticExpressionLexer();
     genCppLexer();
     genCMultilineCommentLexer();
+    genProfiledLexers();
+    genStatsLexer();
+    genRangesLexer();
+    genUnicodeLexer();
+    genSkipLexer();
+    genLinesLexer();
+    genScanLexer();
+    genGlushkovLexer();
+    genNumbersLexer();
+    genSymbolsLexer();
+    genFixedLexer();
 }
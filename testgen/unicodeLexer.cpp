@@ -0,0 +1,29 @@
+#include "lexgen.h"
+
+void genUnicodeLexer()
+{
+    try
+    {
+        LexerGenerator lexGen("Unicode");
+
+        // the code points are matched on their UTF-8 sequences
+        lexGen.addExpression("[_\\p{XID_Start}]\\p{XID_Continue}*", "identifier");
+        lexGen.addExpression("\\p{Nd}+", "number");
+        lexGen.addExpression("\\p{P}+", "punct");
+        lexGen.addExpression("[\\u{1F600}-\\u{1F64F}]+", "emoji");
+        lexGen.addExpression("[ \\t\\n\\u{A0}\\u{3000}]+", "spaces");
+        lexGen.addExpression("\\u{20AC}", "euro");
+
+        if (!lexGen.isUpToDate("cpp", outputPath))
+        {
+            lexGen.generateLexer();
+            lexGen.generateFiles("cpp", outputPath);
+        }
+    }
+    catch (const NanoLexerException& e)
+    {
+        for (const auto& msg : e.getMessages())
+            std::cout << msg << std::endl;
+        exit(1);
+    }
+}
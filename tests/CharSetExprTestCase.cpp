@@ -170,3 +170,17 @@ TEST_F(LexerFixture, Punct) {
 )regexp";
     ASSERT_EQ(debugStr, expected);
 }
+
+// the code points are matched on their UTF-8 sequences: U+00E9 is C3 A9, U+20AC is E2 82 AC
+TEST_F(LexerFixture, CodePoints) {
+    strings exprRegs{ "[a\\u{E9}\\u{20AC}]" };
+    auto debugStr{ generateDebugStr(exprRegs) };
+
+    auto expected =
+        R"regexp(s0:226->s1;195->s2;'a'->accept 1;
+s1:130->s4;
+s2:169->accept 1;
+s4:172->accept 1;
+)regexp";
+    ASSERT_EQ(debugStr, expected);
+}
@@ -0,0 +1,40 @@
+#include <gtest\gtest.h>
+#include <thread>
+#include "../include/NanoLexer.h"
+
+using namespace NanoLexer;
+
+namespace
+{
+    std::string generateDebugStr()
+    {
+        // all the generators have the same name on purpose
+        LexerGenerator lexGen("test");
+        lexGen.addMacro("[0-9]", "Digit");
+        lexGen.addMacro("{Digit}+", "Integer");
+        lexGen.addExpression("class|struct", "keyword");
+        lexGen.addExpression("[a-zA-Z_][a-zA-Z0-9_]*", "id");
+        lexGen.addExpression("{Integer}(\\.{Digit}*)?", "number");
+        lexGen.addExpression("/\\*", "comment")->setPushContext("Comment");
+        lexGen.newContext("Comment");
+        lexGen.addExpression("[^\\*]+");
+        lexGen.addExpression("\\*[^\\/]");
+        lexGen.addExpression("\\*\\/")->setPopAction();
+        lexGen.generateLexer();
+        return lexGen.getDebugString();
+    }
+}
+
+TEST(ConcurrentGeneratorsTest, TestSameResult) {
+    auto expected = generateDebugStr();
+
+    std::vector<std::string> results(8);
+    std::vector<std::thread> threads;
+    for (auto& result : results)
+        threads.emplace_back([&result]() { result = generateDebugStr(); });
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& result : results)
+        ASSERT_EQ(expected, result);
+}
@@ -40,6 +40,14 @@ TEST(ErrorTest, TestPopError) {
     CHECK_NANOLEXEREXCEPTION(lexGen.generateLexer(), "Cannot set a pop action in main context on expression 'hello'");
 }
 
+TEST(ErrorTest, TestSkipError) {
+    LexerGenerator lexGen("test", true);
+    lexGen.addExpression("a", "a");
+    lexGen.newContext("myContext");
+    lexGen.addExpression("b", "b")->setSkip();
+    CHECK_NANOLEXEREXCEPTION(lexGen.generateLexer(), "Cannot skip an expression out of the main context : 'b'");
+}
+
 TEST(ErrorTest, TestExpressionSyntaxError) {
     LexerGenerator lexGen("test", true);
     CHECK_NANOLEXEREXCEPTION(lexGen.addExpression("a|(b]|c", "myExpression"), "syntax error at row 5 in expression 'myExpression'");
@@ -55,6 +63,16 @@ TEST(ErrorTest, TestUnknownMacro) {
     CHECK_NANOLEXEREXCEPTION(lexGen.addExpression("{myMacro}", "myExpression"), "Unknown macro identifier 'myMacro' in expression 'myExpression'");
 }
 
+TEST(ErrorTest, TestUnknownProperty) {
+    LexerGenerator lexGen("test", true);
+    CHECK_NANOLEXEREXCEPTION(lexGen.addExpression("\\p{Foo}+", "myExpression"), "Unknown Unicode property 'Foo' in expression 'myExpression'");
+}
+
+TEST(ErrorTest, TestInvalidCodePoint) {
+    LexerGenerator lexGen("test", true);
+    CHECK_NANOLEXEREXCEPTION(lexGen.addExpression("a[\\u{110000}]", "myExpression"), "Invalid code point or code point range in expression 'myExpression'");
+}
+
 TEST(ErrorTest, TestRepeat1) {
     LexerGenerator lexGen("test", true);
     CHECK_NANOLEXEREXCEPTION(lexGen.addExpression("a{2,1}", "myExpression"), "Maximum occurence count must be greater than the minimum count in expression 'myExpression'");
@@ -79,3 +97,63 @@ TEST(ErrorTest, EmptyExpression2) {
     LexerGenerator lexGen("test", true);
     CHECK_NANOLEXEREXCEPTION(lexGen.addMacro("", "myExpression"), "Invalid empty expression");
 }
+
+TEST(ErrorTest, TooManyStates) {
+    // the DFA of this expression has 2^11 states
+    LexerGenerator lexGen("test");
+    lexGen.addExpression("(a|b)*a(a|b){10}", "myExpression");
+    lexGen.setMaxStateCount(100);
+    CHECK_NANOLEXEREXCEPTION(lexGen.generateLexer(), "Too many states in context 'main_context' : more than 100");
+}
+
+TEST(ErrorTest, StateBudgetIsExact) {
+    // the DFA of this expression has 5 states, the last one accepting
+    LexerGenerator lexGen("test");
+    lexGen.addExpression("abcd", "myExpression");
+    lexGen.setMaxStateCount(5);
+    ASSERT_NO_THROW(lexGen.generateLexer());
+
+    LexerGenerator lexGen2("test");
+    lexGen2.addExpression("abcd", "myExpression");
+    lexGen2.setMaxStateCount(4);
+    CHECK_NANOLEXEREXCEPTION(lexGen2.generateLexer(), "Too many states in context 'main_context' : more than 4");
+}
+
+TEST(ErrorTest, InvalidProfile) {
+    // the state 0 of "ab" has a single transition
+    LexerGenerator lexGen("test");
+    lexGen.addExpression("ab", "myExpression");
+    lexGen.setProfile("main_context 0 1 10\n");
+    CHECK_NANOLEXEREXCEPTION(lexGen.generateLexer(), "Unknown transition 1 of state 0 of context 'main_context' at line 1 of the profile");
+
+    LexerGenerator lexGen2("test");
+    lexGen2.addExpression("ab", "myExpression");
+    lexGen2.setProfile("main_context 0 0 10\nmain_context 1000 0 10\n");
+    CHECK_NANOLEXEREXCEPTION(lexGen2.generateLexer(), "Unknown transition 0 of state 1000 of context 'main_context' at line 2 of the profile");
+
+    LexerGenerator lexGen3("test");
+    lexGen3.addExpression("ab", "myExpression");
+    lexGen3.setProfile("other_context 0 0 10\n");
+    CHECK_NANOLEXEREXCEPTION(lexGen3.generateLexer(), "Unknown context 'other_context' at line 1 of the profile");
+}
+
+TEST(ErrorTest, TooManyStatesWithPush) {
+    // the fallback to the position automaton is refused: it cannot push contexts
+    LexerGenerator lexGen("test");
+    lexGen.addExpression("(a|b)*a(a|b){10}", "myExpression");
+    lexGen.addExpression("c", "myPush")->setPushContext("other");
+    lexGen.newContext("other");
+    lexGen.addExpression("d", "myPop")->setPopAction();
+    lexGen.setMaxStateCount(100);
+    lexGen.setPositionAutomatonFallback(true);
+    CHECK_NANOLEXEREXCEPTION(lexGen.generateLexer(), "Too many states in context 'main_context' : more than 100 and no position automaton: it pushes contexts");
+}
+
+TEST(ErrorTest, TooManyPositions) {
+    // the fallback to the position automaton is refused: its positions do not fit in its sets
+    LexerGenerator lexGen("test");
+    lexGen.addExpression("(a|b)*a(a|b){300}", "myExpression");
+    lexGen.setMaxStateCount(100);
+    lexGen.setPositionAutomatonFallback(true);
+    CHECK_NANOLEXEREXCEPTION(lexGen.generateLexer(), "Too many states in context 'main_context' : more than 100 and no position automaton: more than 256 positions");
+}
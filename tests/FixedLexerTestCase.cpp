@@ -0,0 +1,64 @@
+#include <gtest\gtest.h>
+// with the statistics, which count the lexeme overflow_ as well
+#define NANOLEXER_STATS
+#include <Fixedlexer.h>
+
+using namespace NanoLexer;
+using Lexer = FixedLexer<std::istringstream>;
+
+// the matches up to 16 bytes, with the bytes read ahead put back in the buffer of the lexer
+TEST(FixedLexerTest, TestMatches) {
+    std::istringstream text("abcdefghijklmnop 12 12.5 12. (a short one)");
+    Lexer lexer(text);
+    const std::pair<Lexer::Lexeme, const char*> expected[] = { {Lexer::Lexeme::id_, "abcdefghijklmnop"}
+                                                             , {Lexer::Lexeme::integer_, "12"}
+                                                             , {Lexer::Lexeme::real_, "12.5"}
+                                                             , {Lexer::Lexeme::integer_, "12"}
+                                                             , {Lexer::Lexeme::unknown_, "."}
+                                                             , {Lexer::Lexeme::comment_, "(a short one)"}
+                                                             , {Lexer::Lexeme::eof_, ""} };
+    for (const auto& lexeme : expected)
+    {
+        ASSERT_EQ(lexeme.first, lexer.getNextToken());
+        ASSERT_EQ(lexeme.second, lexer.getMatchString());
+    }
+}
+
+// a longer match is reported, cut at the capacity, and the next match follows it
+TEST(FixedLexerTest, TestOverflow) {
+    std::istringstream text("abcdefghijklmnopqrst 1234567890.123456789 x (a comment longer than the capacity) 7");
+    Lexer lexer(text);
+    const std::pair<Lexer::Lexeme, const char*> expected[] = { {Lexer::Lexeme::overflow_, "abcdefghijklmnop"}
+                                                             , {Lexer::Lexeme::id_, "qrst"}
+                                                             , {Lexer::Lexeme::overflow_, "1234567890.12345"}
+                                                             , {Lexer::Lexeme::integer_, "6789"}
+                                                             , {Lexer::Lexeme::id_, "x"}
+                                                             , {Lexer::Lexeme::overflow_, "(a comment longe"}
+                                                             , {Lexer::Lexeme::id_, "r"}
+                                                             , {Lexer::Lexeme::id_, "than"}
+                                                             , {Lexer::Lexeme::id_, "the"}
+                                                             , {Lexer::Lexeme::id_, "capacity"}
+                                                             , {Lexer::Lexeme::unknown_, ")"}
+                                                             , {Lexer::Lexeme::integer_, "7"}
+                                                             , {Lexer::Lexeme::eof_, ""} };
+    for (const auto& lexeme : expected)
+    {
+        ASSERT_EQ(lexeme.first, lexer.getNextToken()) << lexer.getMatchString();
+        ASSERT_EQ(lexeme.second, lexer.getMatchString());
+    }
+    ASSERT_STREQ("overflow", lexer.getLexemeName(Lexer::Lexeme::overflow_));
+    ASSERT_EQ(3, lexer.getStats().getCount(Lexer::Lexeme::overflow_));
+    ASSERT_EQ(48, lexer.getStats().getBytes(Lexer::Lexeme::overflow_));
+    ASSERT_EQ(1, lexer.getStats().getCount(Lexer::Lexeme::unknown_));
+    ASSERT_EQ(1, lexer.getStats().getCount(Lexer::Lexeme::eof_));
+}
+
+// nothing on the heap: the lexer is the size of its buffers
+TEST(FixedLexerTest, TestInlineStorage) {
+    static_assert(sizeof(Lexer) >= 2 * Lexer::Buffer::capacity, "the buffers are in the lexer");
+    std::istringstream text("abc");
+    Lexer lexer(text);
+    ASSERT_EQ(Lexer::Lexeme::id_, lexer.getNextToken());
+    ASSERT_EQ(0u, lexer.getMatchOffset());
+    ASSERT_EQ(Lexer::Lexeme::eof_, lexer.getNextToken());
+}
@@ -1,5 +1,8 @@
 #include <gtest\gtest.h>
+#include <algorithm>
 #include "LexerFixture.h"
+#include "../include/NanoLexer.h"
+#include "../NanoLexer/LexerTreeNode.h"
 
 TEST_F(LexerFixture, Lexer01) {
     strings exprRegs{ "abc", "[a-z]+" };
@@ -189,3 +192,72 @@ TEST_F(LexerFixture, Lexer14) {
 )regexp";
     ASSERT_EQ(debugStr, expected);
 }
+
+TEST_F(LexerFixture, Lexer15) {
+    strings exprRegs{ "a{0,2}b" };
+    auto debugStr{ generateDebugStr(exprRegs) };
+
+    auto expected =
+        R"regexp(s0:'b'->accept 1;'a'->s2;
+s2:'b'->accept 1;'a'->s3;
+s3:'b'->accept 1;
+)regexp";
+    ASSERT_EQ(debugStr, expected);
+}
+
+TEST_F(LexerFixture, Lexer16) {
+    strings exprRegs{ "(ab){1,3}" };
+    auto debugStr{ generateDebugStr(exprRegs) };
+
+    auto expected =
+        R"regexp(s0:'a'->s1;
+s1:'b'->s2;
+s2:'a'->s3;else->accept 1;
+s3:'b'->s4;
+s4:'a'->s5;else->accept 1;
+s5:'b'->accept 1;
+)regexp";
+    ASSERT_EQ(debugStr, expected);
+}
+
+TEST_F(LexerFixture, Lexer17) {
+    strings exprRegs{ "a{1,200}" };
+    auto debugStr{ generateDebugStr(exprRegs) };
+
+    // one state per occurence
+    ASSERT_EQ(std::count(debugStr.begin(), debugStr.end(), '\n'), 200);
+}
+
+TEST_F(LexerFixture, Lexer18) {
+    // the references to a macro share its tree, the lexer must be the same as with the macro expanded
+    NanoLexer::LexerGenerator generator("test");
+    generator.addMacro("[0-9]", "Digit");
+    generator.addMacro("{Digit}+", "Integer");
+    generator.addExpression("{Integer}\\.{Digit}+", "_0");
+    generator.addExpression("{Integer}|{Digit}{Digit}x", "_1");
+    generator.addExpression("[ \\t]+", "_2");
+    generator.generateLexer();
+
+    strings exprRegs{ "[0-9]+\\.[0-9]+", "[0-9]+|[0-9][0-9]x", "[ \\t]+" };
+    ASSERT_EQ(generator.getDebugString(), generateDebugStr(exprRegs));
+}
+
+TEST_F(LexerFixture, Lexer19) {
+    // deep trees: long literal and counted repetition
+    strings exprRegs{ std::string(2000, 'a') + "b", "c{1,1000}" };
+    auto debugStr{ generateDebugStr(exprRegs) };
+
+    // initial state, one state per character of the literal but the last one, and per occurence but the last one
+    ASSERT_EQ(std::count(debugStr.begin(), debugStr.end(), '\n'), 1 + 2000 + 999);
+}
+
+TEST(LexerTree, DeepTree) {
+    // copy and destruction of a tree far too deep for recursive functions
+    std::shared_ptr<RegularExpression::BaseLexerTreeNode> tree = std::make_shared<RegularExpression::LeafNode>('c');
+    for (int i = 0; i < 300000; i++)
+        tree = std::make_shared<RegularExpression::OptionNode>(tree);
+
+    auto copy = tree->clone();
+    ASSERT_EQ(copy->getPositionCount(), 1);
+    ASSERT_NE(copy.get(), tree.get());
+}
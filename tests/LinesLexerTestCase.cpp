@@ -0,0 +1,64 @@
+#include <gtest\gtest.h>
+// the line index is kept only when NANOLEXER_LINE_INDEX is defined before the inclusion of the lexer
+#define NANOLEXER_LINE_INDEX
+#include <Lineslexer.h>
+
+using namespace NanoLexer;
+using Lexer = LinesLexer<std::istringstream>;
+
+TEST(LinesLexerTest, TestOffsets) {
+    std::istringstream text("ab 12\n  cd\n\nx#");
+    Lexer lexer(text);
+    const std::tuple<Lexer::Lexeme, std::size_t, std::size_t, std::size_t> expected[] = { {Lexer::Lexeme::id_, 0, 1, 1}
+                                                                                        , {Lexer::Lexeme::number_, 3, 1, 4}
+                                                                                        , {Lexer::Lexeme::id_, 8, 2, 3}
+                                                                                        , {Lexer::Lexeme::id_, 12, 4, 1}
+                                                                                        , {Lexer::Lexeme::unknown_, 13, 4, 2}
+                                                                                        , {Lexer::Lexeme::eof_, 14, 4, 3} };
+    for (const auto& token : expected)
+    {
+        ASSERT_EQ(std::get<0>(token), lexer.getNextToken());
+        ASSERT_EQ(std::get<1>(token), lexer.getMatchOffset());
+        auto lineColumn = lexer.lineColumnOf(lexer.getMatchOffset());
+        ASSERT_EQ(std::get<2>(token), lineColumn.first);
+        ASSERT_EQ(std::get<3>(token), lineColumn.second);
+    }
+    // the new line ends its line
+    ASSERT_EQ(1, lexer.lineColumnOf(5).first);
+    ASSERT_EQ(6, lexer.lineColumnOf(5).second);
+}
+
+// the new lines of many matches, looked up in any order
+TEST(LinesLexerTest, TestManyLines) {
+    std::string str;
+    for (int i = 0; i < 5000; i++)
+        str += "abc\n";
+    std::istringstream text(str);
+    Lexer lexer(text);
+    std::vector<std::size_t> offsets;
+    while (lexer.getNextToken() != Lexer::Lexeme::eof_)
+        offsets.push_back(lexer.getMatchOffset());
+    ASSERT_EQ(5000, offsets.size());
+    ASSERT_EQ(1, lexer.lineColumnOf(offsets[0]).first);
+    ASSERT_EQ(1500, lexer.lineColumnOf(offsets[1499]).first);
+    ASSERT_EQ(1000, lexer.lineColumnOf(offsets[999]).first);
+    ASSERT_EQ(5000, lexer.lineColumnOf(offsets[4999]).first);
+    ASSERT_EQ(3, lexer.lineColumnOf(offsets[4999] + 2).second);
+}
+
+// the lines asked for while lexing, the block being scanned before it is full
+TEST(LinesLexerTest, TestLinesWhileLexing) {
+    std::string str;
+    for (int i = 0; i < 3000; i++)
+        str += "abc\n";
+    std::istringstream text(str);
+    Lexer lexer(text);
+    std::size_t line = 0;
+    while (lexer.getNextToken() != Lexer::Lexeme::eof_)
+    {
+        auto lineColumn = lexer.lineColumnOf(lexer.getMatchOffset());
+        if (lineColumn.second == 1)
+            ASSERT_EQ(++line, lineColumn.first);
+    }
+    ASSERT_EQ(3000, line);
+}
@@ -0,0 +1,51 @@
+#include <gtest\gtest.h>
+#include "../include/NanoLexer.h"
+
+using namespace NanoLexer;
+
+namespace
+{
+    void checkMatch(Matcher& matcher, const std::string& text, int lexeme, std::size_t length)
+    {
+        std::size_t matchLength;
+        ASSERT_EQ(lexeme, matcher.longestMatch(text.data(), text.data() + text.size(), matchLength)) << text;
+        ASSERT_EQ(length, matchLength) << text;
+    }
+}
+
+// the lexemes are numbered as in the generated lexer, from 1 in the order of declaration
+TEST(MatcherTest, TestLongestMatch) {
+    LexerGenerator lexGen("Matcher");
+    lexGen.addMacro("[0-9]", "digit");
+    lexGen.addExpression("if", "if");
+    lexGen.addExpression("[a-z]+", "id");
+    lexGen.addExpression("{digit}+", "number");
+    lexGen.addVerbatimExpression("+=", "plusEqual");
+    lexGen.newContext("comment");
+    lexGen.addExpression("\\*/", "end")->setPopAction();
+    auto matcher = lexGen.createMatcher(100);
+    checkMatch(*matcher, "if(", 1, 2);
+    checkMatch(*matcher, "iff", 2, 3);
+    checkMatch(*matcher, "123a", 3, 3);
+    checkMatch(*matcher, "+=1", 4, 2);
+    checkMatch(*matcher, "*/", -1, 0);
+    checkMatch(*matcher, "", -1, 0);
+}
+
+// the DFA of this expression has 2^11 states: the matcher computes only those it reaches, in a cache of a few states
+TEST(MatcherTest, TestSmallCache) {
+    LexerGenerator lexGen("Matcher");
+    lexGen.addExpression("(a|b)*a(a|b){10}", "tail");
+    auto matcher = lexGen.createMatcher(8);
+    auto text = std::string(50, 'b') + "a" + std::string(10, 'b');
+    checkMatch(*matcher, text, 1, 61);
+    checkMatch(*matcher, text.substr(0, 60), -1, 0);
+    ASSERT_TRUE(matcher->getStateCount() <= 8);
+    ASSERT_TRUE(matcher->getFlushCount() > 0);
+}
+
+TEST(MatcherTest, TestModelError) {
+    LexerGenerator lexGen("Matcher");
+    lexGen.addExpression("(a", "bad");
+    ASSERT_THROW(lexGen.createMatcher(100), NanoLexerException);
+}
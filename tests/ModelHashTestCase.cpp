@@ -0,0 +1,82 @@
+#include <gtest\gtest.h>
+#include "../include/NanoLexer.h"
+
+using namespace NanoLexer;
+
+namespace
+{
+    void defineModel(LexerGenerator& lexGen, const std::string& keyword)
+    {
+        lexGen.addExpression(keyword, "keyword");
+        lexGen.addExpression("[a-z]+", "id");
+        lexGen.newContext("Comment");
+        lexGen.addExpression("\\*\\/")->setPopAction();
+    }
+}
+
+TEST(ModelHashTest, TestUpToDate) {
+    {
+        LexerGenerator lexGen("ModelHash");
+        defineModel(lexGen, "class");
+        lexGen.generateLexer();
+        lexGen.generateFiles("cpp", ".");
+    }
+    LexerGenerator lexGen("ModelHash");
+    defineModel(lexGen, "class");
+    ASSERT_TRUE(lexGen.isUpToDate("cpp", "."));
+}
+
+TEST(ModelHashTest, TestModelChanged) {
+    {
+        LexerGenerator lexGen("ModelHash");
+        defineModel(lexGen, "class");
+        lexGen.generateLexer();
+        lexGen.generateFiles("cpp", ".");
+    }
+    LexerGenerator lexGen("ModelHash");
+    defineModel(lexGen, "struct");
+    ASSERT_FALSE(lexGen.isUpToDate("cpp", "."));
+}
+
+TEST(ModelHashTest, TestCodeChanged) {
+    {
+        LexerGenerator lexGen("ModelHash");
+        defineModel(lexGen, "class");
+        lexGen.generateLexer();
+        lexGen.generateFiles("cpp", ".");
+    }
+    LexerGenerator lexGen("ModelHash");
+    defineModel(lexGen, "class");
+    lexGen.addPrivateMembers("int line;");
+    ASSERT_FALSE(lexGen.isUpToDate("cpp", "."));
+}
+
+TEST(ModelHashTest, TestProfileChanged) {
+    {
+        LexerGenerator lexGen("ModelHash");
+        defineModel(lexGen, "class");
+        lexGen.generateLexer();
+        lexGen.generateFiles("cpp", ".");
+    }
+    LexerGenerator lexGen("ModelHash");
+    defineModel(lexGen, "class");
+    lexGen.setProfile("main_context 0 0 10\n");
+    ASSERT_FALSE(lexGen.isUpToDate("cpp", "."));
+}
+
+// with the position automaton fallback, the budget of states decides between a DFA and an automaton
+TEST(ModelHashTest, TestMaxStateCountChanged) {
+    {
+        LexerGenerator lexGen("ModelHash");
+        defineModel(lexGen, "class");
+        lexGen.setPositionAutomatonFallback(true);
+        lexGen.setMaxStateCount(1000);
+        lexGen.generateLexer();
+        lexGen.generateFiles("cpp", ".");
+    }
+    LexerGenerator lexGen("ModelHash");
+    defineModel(lexGen, "class");
+    lexGen.setPositionAutomatonFallback(true);
+    lexGen.setMaxStateCount(4);
+    ASSERT_FALSE(lexGen.isUpToDate("cpp", "."));
+}
@@ -0,0 +1,39 @@
+#include <gtest\gtest.h>
+#include <Numberslexer.h>
+
+using namespace NanoLexer;
+using Lexer = NumbersLexer<std::istringstream>;
+
+// the value of each number lexeme, accumulated by the states of the lexer (meaningless for the other lexemes)
+TEST(NumbersLexerTest, TestValues) {
+    std::istringstream text("0 42 0x1F 0xfF 0b1011 &o17 007 1_000_000 12.5 12.x x12 18446744073709551615 " + std::string(70, '9') + " 7");
+    Lexer lexer(text);
+    const std::pair<Lexer::Lexeme, unsigned long long> expected[] = { {Lexer::Lexeme::decimal_, 0}
+                                                                    , {Lexer::Lexeme::decimal_, 42}
+                                                                    , {Lexer::Lexeme::hexadecimal_, 31}
+                                                                    , {Lexer::Lexeme::hexadecimal_, 255}
+                                                                    , {Lexer::Lexeme::binary_, 11}
+                                                                    , {Lexer::Lexeme::octal_, 15}
+                                                                    , {Lexer::Lexeme::decimal_, 7}
+                                                                    , {Lexer::Lexeme::grouped_, 1000000}
+                                                                    , {Lexer::Lexeme::real_, 12}
+                                                                    , {Lexer::Lexeme::decimal_, 12}
+                                                                    , {Lexer::Lexeme::unknown_, 12}
+                                                                    , {Lexer::Lexeme::id_, 12}
+                                                                    , {Lexer::Lexeme::id_, 12}
+                                                                    , {Lexer::Lexeme::decimal_, 18446744073709551615ULL} };
+    for (const auto& lexeme : expected)
+    {
+        ASSERT_EQ(lexeme.first, lexer.getNextToken()) << lexer.getMatchString();
+        ASSERT_EQ(lexeme.second, lexer.getIntegerValue()) << lexer.getMatchString();
+    }
+    // the value of a longer number wraps around
+    ASSERT_EQ(Lexer::Lexeme::decimal_, lexer.getNextToken());
+    unsigned long long value = 0;
+    for (int i = 0; i < 70; i++)
+        value = value * 10 + 9;
+    ASSERT_EQ(value, lexer.getIntegerValue());
+    ASSERT_EQ(Lexer::Lexeme::decimal_, lexer.getNextToken());
+    ASSERT_EQ(7ULL, lexer.getIntegerValue());
+    ASSERT_EQ(Lexer::Lexeme::eof_, lexer.getNextToken());
+}
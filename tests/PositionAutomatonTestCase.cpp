@@ -0,0 +1,149 @@
+#include <gtest\gtest.h>
+#include <Glushkovlexer.h>
+#include "checkLexemes.h"
+#include "../NanoLexer/LexerBuilder.h"
+#include "../NanoLexer/shared.h"
+
+using namespace NanoLexer;
+using Lexer = GlushkovLexer<std::istringstream>;
+
+namespace
+{
+    // main context of the expressions (lexemes 1, 2...)
+    std::unique_ptr<RegularExpression::LexerContext> makeContext(const std::vector<std::string>& expressions)
+    {
+        using namespace RegularExpression;
+        MacroTrees macros;
+        std::vector<std::string> errorMessages;
+        std::vector<std::shared_ptr<BaseLexerTreeNode>> trees;
+        int id = 1;
+        for (const auto& expression : expressions)
+        {
+            auto concatNode = makeShared<ConcatNode>();
+            concatNode->addChild(parseString(expression.c_str(), "", macros, errorMessages));
+            concatNode->addChild(makeShared<EndNode>(id++));
+            trees.push_back(std::move(concatNode));
+        }
+        auto context = std::make_unique<LexerContext>("main_context", (int)expressions.size(), std::set<int>());
+        context->setExpRegList(std::move(trees));
+        return context;
+    }
+
+    // the same simulated by its position automaton, when it can
+    std::unique_ptr<RegularExpression::LexerContext> makeAutomatonContext(const std::vector<std::string>& expressions, int maxStateCount)
+    {
+        auto context = makeContext(expressions);
+        context->ComputeLexer(maxStateCount);
+        context->usePositionAutomaton();
+        return context;
+    }
+
+    void checkMatch(const RegularExpression::PositionAutomaton& automaton, const std::string& text, int lexeme, std::size_t length)
+    {
+        std::size_t matchLength;
+        ASSERT_EQ(lexeme, automaton.longestMatch(text.data(), text.data() + text.size(), matchLength)) << text;
+        ASSERT_EQ(length, matchLength) << text;
+    }
+}
+
+// the generated lexer simulates the position automaton of its main context, whose DFA is too large
+TEST(PositionAutomatonTest, TestLexemes) {
+    std::string text = "abababababab babababababa aaaaaaaaaaa bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbaaaaaaaaaa abc-x";
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes = { {Lexer::Lexeme::word_, "abababababab"}
+                                                        , {Lexer::Lexeme::tail_, "babababababa"}
+                                                        , {Lexer::Lexeme::tail_, "aaaaaaaaaaa"}
+                                                        , {Lexer::Lexeme::word_, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbaaaaaaaaaa"}
+                                                        , {Lexer::Lexeme::word_, "abc"}
+                                                        , {Lexer::Lexeme::unknown_, "-"}
+                                                        , {Lexer::Lexeme::word_, "x"} };
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
+
+// the failure code of the context runs for each byte that starts no match
+TEST(PositionAutomatonTest, TestOnFailure) {
+    std::istringstream text("abc-x+ b");
+    Lexer lexer(text);
+    while (lexer.getNextToken() != Lexer::Lexeme::eof_)
+        ;
+    ASSERT_EQ(2, lexer.failureCount);
+}
+
+// the longest match, and the first expression for a tie
+TEST(PositionAutomatonTest, TestLongestMatch) {
+    auto context = makeAutomatonContext({ "(a|b)*a(a|b){20}", "[ab]+c" }, 100);
+    const auto* automaton = context->getPositionAutomaton();
+    ASSERT_TRUE(automaton != nullptr);
+    checkMatch(*automaton, "a" + std::string(20, 'b'), 1, 21);
+    checkMatch(*automaton, "aa" + std::string(20, 'b') + "d", 1, 22);
+    checkMatch(*automaton, "a" + std::string(25, 'b') + "c", 2, 27);
+    checkMatch(*automaton, std::string(30, 'b'), -1, 0);
+    checkMatch(*automaton, "", -1, 0);
+    ASSERT_TRUE(automaton->canStart('a'));
+    ASSERT_FALSE(automaton->canStart('c'));
+}
+
+// more than 64 positions: the masks span several words
+TEST(PositionAutomatonTest, TestSeveralWords) {
+    auto context = makeAutomatonContext({ "x(a|b){80}", "x[a-z]*y" }, 0);
+    const auto* automaton = context->getPositionAutomaton();
+    ASSERT_TRUE(automaton != nullptr);
+    ASSERT_EQ(164, automaton->getPositionCount());
+    std::string ab;
+    for (int i = 0; i < 40; i++)
+        ab += "ab";
+    checkMatch(*automaton, "x" + ab + "ab", 1, 81);
+    checkMatch(*automaton, "x" + ab + "y", 2, 82);
+    checkMatch(*automaton, "x" + ab.substr(0, 79), -1, 0);
+}
+
+// the tables are bounded: there is no automaton beyond the maximum number of positions
+TEST(PositionAutomatonTest, TestTooManyPositions) {
+    auto context = makeAutomatonContext({ "a{300}" }, 0);
+    ASSERT_TRUE(context->getPositionAutomaton() == nullptr);
+}
+
+// the lazy DFA finds the same matches as the position automaton, with a cache of a few states flushed when full
+TEST(PositionAutomatonTest, TestLazyDfa) {
+    const std::vector<std::string> expressions = { "(a|b)*a(a|b){10}", "[ab]+c", "c+" };
+    auto automatonContext = makeAutomatonContext(expressions, 100);
+    const auto* automaton = automatonContext->getPositionAutomaton();
+    ASSERT_TRUE(automaton != nullptr);
+    auto context = makeContext(expressions);
+    context->computePositions();
+    RegularExpression::LazyDfa dfa(context->getFirstPositions(), context->getFollowPositions(), 16);
+
+    unsigned int random = 12345;
+    for (int i = 0; i < 500; i++)
+    {
+        std::string text;
+        auto size = i % 40;
+        for (int j = 0; j < size; j++)
+        {
+            random = random * 1103515245 + 12345;
+            text += "aabbabc"[(random >> 16) % 7];
+        }
+        std::size_t expectedLength, length;
+        auto expected = automaton->longestMatch(text.data(), text.data() + text.size(), expectedLength);
+        ASSERT_EQ(expected, dfa.longestMatch(text.data(), text.data() + text.size(), length)) << text;
+        ASSERT_EQ(expectedLength, length) << text;
+        ASSERT_TRUE(dfa.getStateCount() <= 16);
+    }
+    ASSERT_TRUE(dfa.getFlushCount() > 0);
+}
+
+// a flush keeps the start state: the next match reuses the cache instead of wiping it again
+TEST(PositionAutomatonTest, TestLazyDfaFlush) {
+    auto context = makeContext({ "a{20}" });
+    context->computePositions();
+    RegularExpression::LazyDfa dfa(context->getFirstPositions(), context->getFollowPositions(), 4);
+    std::string text(20, 'a');
+    std::size_t length;
+    ASSERT_EQ(1, dfa.longestMatch(text.data(), text.data() + text.size(), length));
+    ASSERT_EQ(20u, length);
+    // 21 states: the cache keeps the start state and the current one, and takes 2 new ones between two flushes
+    ASSERT_EQ(9u, dfa.getFlushCount());
+    auto stateCount = dfa.getStateCount();
+    ASSERT_EQ(-1, dfa.longestMatch(text.data(), text.data(), length));
+    ASSERT_EQ(stateCount, dfa.getStateCount());
+    ASSERT_EQ(9u, dfa.getFlushCount());
+}
@@ -0,0 +1,36 @@
+#include <gtest\gtest.h>
+#include <Profiledlexer.h>
+#include <Guidedlexer.h>
+#include "checkLexemes.h"
+
+using namespace NanoLexer;
+
+TEST(ProfiledLexerTest, TestWriteProfile) {
+    std::istringstream text("abcd");
+    ProfiledLexer<std::istringstream> lexer(text);
+    while (lexer.getNextToken() != ProfiledLexer<std::istringstream>::Lexeme::eof_);
+
+    std::ostringstream profile;
+    lexer.writeProfile(profile);
+    // the first letter is read by the state 0 and the others by the state of the identifiers
+    ASSERT_EQ("main_context 0 4 1\nmain_context 5 0 3\n", profile.str());
+}
+
+TEST(ProfiledLexerTest, TestGuidedLexer) {
+    using Lexer = GuidedLexer<std::istringstream>;
+    std::string text = "object.member  classes\tclass 12.5 7\r\n_c2";
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes = { {Lexer::Lexeme::id_, "object"}
+                                                        , {Lexer::Lexeme::dot_, "."}
+                                                        , {Lexer::Lexeme::id_, "member"}
+                                                        , {Lexer::Lexeme::whitespace_, "  "}
+                                                        , {Lexer::Lexeme::id_, "classes"}
+                                                        , {Lexer::Lexeme::whitespace_, "\t"}
+                                                        , {Lexer::Lexeme::class_, "class"}
+                                                        , {Lexer::Lexeme::whitespace_, " "}
+                                                        , {Lexer::Lexeme::number_, "12.5"}
+                                                        , {Lexer::Lexeme::whitespace_, " "}
+                                                        , {Lexer::Lexeme::number_, "7"}
+                                                        , {Lexer::Lexeme::new_line_, "\r\n"}
+                                                        , {Lexer::Lexeme::id_, "_c2"} };
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
@@ -0,0 +1,67 @@
+#include <gtest\gtest.h>
+#include <cctype>
+#include <cstring>
+#include <Rangeslexer.h>
+#include "checkLexemes.h"
+
+using namespace NanoLexer;
+using Lexer = RangesLexer<std::istringstream>;
+
+namespace
+{
+    Lexer::Lexeme firstLexeme(const std::string& str)
+    {
+        std::istringstream text(str);
+        Lexer lexer(text);
+        return lexer.getNextToken();
+    }
+}
+
+TEST(RangesLexerTest, TestLexemes) {
+    std::string text = "Aeiou bcd, 12 0x+-*/ xyz!";
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes = { {Lexer::Lexeme::vowels_, "Aeiou"}
+                                                        , {Lexer::Lexeme::spaces_, " "}
+                                                        , {Lexer::Lexeme::consonants_, "bcd"}
+                                                        , {Lexer::Lexeme::punct_, ","}
+                                                        , {Lexer::Lexeme::spaces_, " "}
+                                                        , {Lexer::Lexeme::digits_, "12"}
+                                                        , {Lexer::Lexeme::spaces_, " "}
+                                                        , {Lexer::Lexeme::symbols_, "0x+-*/"}
+                                                        , {Lexer::Lexeme::spaces_, " "}
+                                                        , {Lexer::Lexeme::consonants_, "xyz"}
+                                                        , {Lexer::Lexeme::punct_, "!"} };
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
+
+// each character is tested against each kind of dispatch
+TEST(RangesLexerTest, TestAllCharacters) {
+    for (int c = 1; c < 256; c++)
+    {
+        std::string str(1, (char)c);
+        auto expected = Lexer::Lexeme::unknown_;
+        if (c < 128 && std::strchr("aeiouAEIOU", c))
+            expected = Lexer::Lexeme::vowels_;
+        else if (c < 128 && std::isalpha(c))
+            expected = Lexer::Lexeme::consonants_;
+        else if (c < 128 && std::ispunct(c))
+            expected = Lexer::Lexeme::punct_;
+        else if (c >= '1' && c <= '9')
+            expected = Lexer::Lexeme::digits_;
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            expected = Lexer::Lexeme::spaces_;
+        ASSERT_EQ(expected, firstLexeme(str)) << "character " << c;
+
+        auto isSymbol = !(c < 128 && (std::isalnum(c) || c == '_')) && c != ' ';
+        ASSERT_EQ(isSymbol, firstLexeme("0x" + str) == Lexer::Lexeme::symbols_) << "character " << c;
+    }
+}
+
+// a byte above 0x7F read after a lexeme is put back, then read again by the next token: it must not be sign extended
+TEST(RangesLexerTest, TestHighByteReadAgain) {
+    std::string text = "b\xE9" "a\xFF";
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes = { {Lexer::Lexeme::consonants_, "b"}
+                                                        , {Lexer::Lexeme::unknown_, "\xE9"}
+                                                        , {Lexer::Lexeme::vowels_, "a"}
+                                                        , {Lexer::Lexeme::unknown_, "\xFF"} };
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
@@ -0,0 +1,69 @@
+#include <gtest\gtest.h>
+#include <Scanlexer.h>
+
+using namespace NanoLexer;
+using Lexer = ScanLexer<std::istringstream>;
+
+namespace
+{
+    struct Found
+    {
+        Lexer::Lexeme lex;
+        std::size_t offset;
+        std::string str;
+    };
+
+    void checkFound(const std::string& str, const std::vector<Found>& expected)
+    {
+        std::istringstream text(str);
+        Lexer lexer(text);
+        for (const auto& found : expected)
+        {
+            ASSERT_EQ(found.lex, lexer.findNextToken());
+            ASSERT_EQ(found.offset, lexer.getMatchOffset());
+            ASSERT_EQ(found.str, lexer.getMatchString());
+        }
+        ASSERT_EQ(Lexer::Lexeme::eof_, lexer.findNextToken());
+        ASSERT_EQ(Lexer::Lexeme::eof_, lexer.findNextToken());
+    }
+}
+
+// the leftmost match and the longest one at its offset, the failed attempts being skipped
+TEST(ScanLexerTest, TestFind) {
+    checkFound("at 10.0.0.1 got E1234, E12 [E9999] 1.2.3 E123456 EE0042 192.168.1.12",
+        { {Lexer::Lexeme::ip_, 3, "10.0.0.1"}
+        , {Lexer::Lexeme::error_, 16, "E1234"}
+        , {Lexer::Lexeme::error_, 41, "E1234"}
+        , {Lexer::Lexeme::error_, 50, "E0042"}
+        , {Lexer::Lexeme::ip_, 56, "192.168.1.12"} });
+    checkFound("", {});
+    checkFound("no match here", {});
+}
+
+// matches spread over blocks of 64 bytes and over the blocks read ahead
+TEST(ScanLexerTest, TestLongText) {
+    std::string text;
+    std::vector<Found> expected;
+    for (int i = 0; i < 300; i++)
+    {
+        text += std::string(i * 7 % 130, (i % 2) ? 'x' : ' ');
+        std::string error = "E" + std::to_string(1000 + i);
+        expected.push_back({ Lexer::Lexeme::error_, text.size(), error });
+        text += error;
+    }
+    checkFound(text, expected);
+}
+
+// an attempt failing at the end of the input, the matches it spans being found
+TEST(ScanLexerTest, TestLongBacktrack) {
+    checkFound("[" + std::string(200000, 'a') + " E1234",
+        { {Lexer::Lexeme::error_, 200002, "E1234"} });
+}
+
+// the attempts from each digit fail at the same byte: the digits are read once, not once per attempt
+TEST(ScanLexerTest, TestLongFailures) {
+    checkFound(std::string(200000, '1') + " 1.2.3.4",
+        { {Lexer::Lexeme::ip_, 200001, "1.2.3.4"} });
+    checkFound(std::string(100000, '[') + " 1.2.3.4",
+        { {Lexer::Lexeme::ip_, 100001, "1.2.3.4"} });
+}
@@ -0,0 +1,51 @@
+#include <gtest\gtest.h>
+#include <Skiplexer.h>
+#include "checkLexemes.h"
+
+using namespace NanoLexer;
+using Lexer = SkipLexer<std::istringstream>;
+
+// the spaces, new lines and comments are consumed by getNextToken()
+TEST(SkipLexerTest, TestLexemes) {
+    std::string text = "  abc 12\n\tx /* a\n * b */ 3 # y /**/";
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes = { {Lexer::Lexeme::id_, "abc"}
+                                                        , {Lexer::Lexeme::number_, "12"}
+                                                        , {Lexer::Lexeme::id_, "x"}
+                                                        , {Lexer::Lexeme::number_, "3"}
+                                                        , {Lexer::Lexeme::unknown_, "#"}
+                                                        , {Lexer::Lexeme::id_, "y"} };
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
+
+// the match code of the skipped expressions is executed
+TEST(SkipLexerTest, TestLines) {
+    std::istringstream text("a\n\nb /* x */\n\n\nc\n\n");
+    Lexer lexer(text);
+    const std::pair<Lexer::Lexeme, int> expected[] = { {Lexer::Lexeme::id_, 1}
+                                                     , {Lexer::Lexeme::id_, 3}
+                                                     , {Lexer::Lexeme::id_, 6}
+                                                     , {Lexer::Lexeme::eof_, 8} };
+    for (const auto& lexeme : expected)
+    {
+        ASSERT_EQ(lexeme.first, lexer.getNextToken());
+        ASSERT_EQ(lexeme.second, lexer.getCurrentLine());
+    }
+}
+
+// runs shorter and longer than the blocks of 64 bytes of the run scan, at every alignment, up to the end of the input
+TEST(SkipLexerTest, TestLongRuns) {
+    std::string text;
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes;
+    for (int length = 1; length < 200; length += 7)
+    {
+        std::string id(length, (char)('a' + length % 26));
+        std::string number(length / 2 + 1, '7');
+        text += id + std::string(length, ' ') + number + "\t/*" + std::string(length, '-') + "*" + std::string(length % 70, 'x') + "*/";
+        expectedLexemes.push_back({ Lexer::Lexeme::id_, id });
+        expectedLexemes.push_back({ Lexer::Lexeme::number_, number });
+    }
+    text += "#" + std::string(150, 'z');
+    expectedLexemes.push_back({ Lexer::Lexeme::unknown_, "#" });
+    expectedLexemes.push_back({ Lexer::Lexeme::id_, std::string(150, 'z') });
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
@@ -0,0 +1,51 @@
+#include <gtest\gtest.h>
+// the statistics are recorded only when NANOLEXER_STATS is defined before the inclusion of the lexer
+#define NANOLEXER_STATS
+#include <Statslexer.h>
+
+using namespace NanoLexer;
+using Lexer = StatsLexer<std::istringstream>;
+
+TEST(StatsLexerTest, TestStats) {
+    std::istringstream text("abc 1. /* x * y */12.5#");
+    Lexer lexer(text);
+    int count = 0;
+    while (lexer.getNextToken() != Lexer::Lexeme::eof_)
+        count++;
+
+    const auto& stats = lexer.getStats();
+    ASSERT_EQ(8, count);
+    ASSERT_EQ(1, stats.getCount(Lexer::Lexeme::id_));
+    ASSERT_EQ(3, stats.getBytes(Lexer::Lexeme::id_));
+    ASSERT_EQ(2, stats.getCount(Lexer::Lexeme::number_));
+    ASSERT_EQ(5, stats.getBytes(Lexer::Lexeme::number_));
+    ASSERT_EQ(2, stats.getCount(Lexer::Lexeme::whitespace_));
+    ASSERT_EQ(1, stats.getCount(Lexer::Lexeme::comment_));
+    ASSERT_EQ(11, stats.getBytes(Lexer::Lexeme::comment_));
+    ASSERT_EQ(2, stats.getCount(Lexer::Lexeme::unknown_));    // "." and "#"
+    ASSERT_EQ(2, stats.getBytes(Lexer::Lexeme::unknown_));
+    ASSERT_EQ(1, stats.getCount(Lexer::Lexeme::eof_));
+    ASSERT_EQ(1, stats.pushCount);
+    ASSERT_EQ(1, stats.popCount);
+    // "1." is matched as "1" after reading ". "
+    ASSERT_EQ(1, stats.backtracks[2]);
+
+    lexer.resetStats();
+    ASSERT_EQ(0, lexer.getStats().getCount(Lexer::Lexeme::id_));
+}
+
+// the states of "[a-z]+" accept when they are left: on the character after the match, or at the end of the input
+TEST(StatsLexerTest, TestAcceptOnExit) {
+    std::istringstream text("ab cd");
+    Lexer lexer(text);
+    ASSERT_EQ(Lexer::Lexeme::id_, lexer.getNextToken());
+    ASSERT_EQ("ab", lexer.getMatchString());
+    ASSERT_EQ(Lexer::Lexeme::whitespace_, lexer.getNextToken());
+    ASSERT_EQ(Lexer::Lexeme::id_, lexer.getNextToken());
+    ASSERT_EQ("cd", lexer.getMatchString());
+    ASSERT_EQ(Lexer::Lexeme::eof_, lexer.getNextToken());
+
+    const auto& stats = lexer.getStats();
+    ASSERT_EQ(2, stats.backtracks[1]);      // "ab" and " "
+    ASSERT_EQ(2, stats.backtracks[0]);      // "cd" and the end
+}
@@ -0,0 +1,61 @@
+#include <gtest\gtest.h>
+#include <Symbolslexer.h>
+
+using namespace NanoLexer;
+using Lexer = SymbolsLexer<std::istringstream>;
+
+// the same identifier gets the same id, numbered by first occurrence
+TEST(SymbolsLexerTest, TestIds) {
+    std::istringstream text("count = count + if1; if (x) iff = count_2 * x;");
+    Lexer lexer(text);
+    const std::pair<Lexer::Lexeme, int> expected[] = { {Lexer::Lexeme::id_, 0}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::id_, 0}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::id_, 1}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::if_keyword_, -1}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::id_, 2}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::id_, 3}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::id_, 4}
+                                                     , {Lexer::Lexeme::punctuation_, -1}
+                                                     , {Lexer::Lexeme::id_, 2}
+                                                     , {Lexer::Lexeme::punctuation_, -1} };
+    for (const auto& lexeme : expected)
+    {
+        // no id for the other lexemes, even "if" whose prefix "i" was accepted as an identifier
+        ASSERT_EQ(lexeme.first, lexer.getNextToken()) << lexer.getMatchString();
+        ASSERT_EQ((unsigned)lexeme.second, lexer.getSymbolId()) << lexer.getMatchString();
+    }
+    ASSERT_EQ(Lexer::Lexeme::eof_, lexer.getNextToken());
+    ASSERT_EQ(5u, lexer.getSymbolCount());
+    const char* texts[] = { "count", "if1", "x", "iff", "count_2" };
+    for (unsigned id = 0; id < 5; id++)
+        ASSERT_EQ(texts[id], lexer.getSymbolText(id));
+}
+
+// the table of the symbols grows while they are interned, the ids are kept
+TEST(SymbolsLexerTest, TestManySymbols) {
+    std::string source;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < 1000; i++)
+            source += "s" + std::to_string(i) + " ";
+    }
+    std::istringstream text(source);
+    Lexer lexer(text);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (unsigned i = 0; i < 1000; i++)
+        {
+            ASSERT_EQ(Lexer::Lexeme::id_, lexer.getNextToken());
+            ASSERT_EQ(i, lexer.getSymbolId());
+        }
+    }
+    ASSERT_EQ(Lexer::Lexeme::eof_, lexer.getNextToken());
+    ASSERT_EQ(1000u, lexer.getSymbolCount());
+    ASSERT_EQ("s999", lexer.getSymbolText(999));
+}
@@ -0,0 +1,102 @@
+#include <gtest\gtest.h>
+#include <Unicodelexer.h>
+#include "checkLexemes.h"
+
+using namespace NanoLexer;
+using Lexer = UnicodeLexer<std::istringstream>;
+
+namespace
+{
+    Lexer::Lexeme firstLexeme(const std::string& str, std::string& match)
+    {
+        std::istringstream text(str);
+        Lexer lexer(text);
+        auto lexeme = lexer.getNextToken();
+        match = lexer.getMatchString();
+        return lexeme;
+    }
+
+    std::string toUtf8(int codePoint)
+    {
+        std::string str;
+        if (codePoint < 0x80)
+            str += (char)codePoint;
+        else if (codePoint < 0x800)
+        {
+            str += (char)(0xC0 | (codePoint >> 6));
+            str += (char)(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            str += (char)(0xE0 | (codePoint >> 12));
+            str += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            str += (char)(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            str += (char)(0xF0 | (codePoint >> 18));
+            str += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+            str += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            str += (char)(0x80 | (codePoint & 0x3F));
+        }
+        return str;
+    }
+}
+
+// the input is UTF-8: the code points are given by their escaped bytes
+TEST(UnicodeLexerTest, TestLexemes) {
+    std::string text = "\xC3\xA9t\xC3\xA9 \xCE\x94x2\xE3\x80\x80\xE6\xBC\xA2\xE5\xAD\x97,\xC2\xAB\xD9\xA4\xD9\xA2\xC2\xA0\xF0\x9F\x98\x80\xF0\x9F\x98\x83\xE2\x82\xAC _a1";
+    std::vector<Token<Lexer::Lexeme>> expectedLexemes = { {Lexer::Lexeme::identifier_, "\xC3\xA9t\xC3\xA9"}     // été
+                                                        , {Lexer::Lexeme::spaces_, " "}
+                                                        , {Lexer::Lexeme::identifier_, "\xCE\x94x2"}            // Δx2
+                                                        , {Lexer::Lexeme::spaces_, "\xE3\x80\x80"}              // U+3000
+                                                        , {Lexer::Lexeme::identifier_, "\xE6\xBC\xA2\xE5\xAD\x97"}  // U+6F22 U+5B57
+                                                        , {Lexer::Lexeme::punct_, ",\xC2\xAB"}                  // ,«
+                                                        , {Lexer::Lexeme::number_, "\xD9\xA4\xD9\xA2"}          // arabic-indic 42
+                                                        , {Lexer::Lexeme::spaces_, "\xC2\xA0"}                  // U+00A0
+                                                        , {Lexer::Lexeme::emoji_, "\xF0\x9F\x98\x80\xF0\x9F\x98\x83"}
+                                                        , {Lexer::Lexeme::euro_, "\xE2\x82\xAC"}
+                                                        , {Lexer::Lexeme::spaces_, " "}
+                                                        , {Lexer::Lexeme::identifier_, "_a1"} };
+    checkLexemes<Lexer, Lexer::Lexeme>(text, expectedLexemes);
+}
+
+// the sequences are matched as a whole: a truncated or an invalid sequence is unknown
+TEST(UnicodeLexerTest, TestInvalidSequences) {
+    std::string match;
+    EXPECT_EQ(Lexer::Lexeme::unknown_, firstLexeme("\xC3", match));
+    EXPECT_EQ(Lexer::Lexeme::unknown_, firstLexeme("\xC3(", match));
+    EXPECT_EQ(Lexer::Lexeme::unknown_, firstLexeme("\x80", match));
+    EXPECT_EQ(Lexer::Lexeme::unknown_, firstLexeme("\xE2\x82", match));
+    EXPECT_EQ(Lexer::Lexeme::unknown_, firstLexeme("\xED\xA0\x80", match));    // surrogate U+D800
+    EXPECT_EQ(Lexer::Lexeme::identifier_, firstLexeme("a\xC3", match));
+    EXPECT_EQ("a", match);
+}
+
+// bounds of the lengths of the UTF-8 sequences, and code points that are not in the classes
+TEST(UnicodeLexerTest, TestCodePoints) {
+    const std::pair<int, Lexer::Lexeme> codePoints[] = { {0x7A, Lexer::Lexeme::identifier_}     // z
+                                                       , {0xAA, Lexer::Lexeme::identifier_}     // ª: first letter of 2 bytes
+                                                       , {0xD7, Lexer::Lexeme::unknown_}        // ×
+                                                       , {0x7FA, Lexer::Lexeme::identifier_}    // last letter of 2 bytes
+                                                       , {0x800, Lexer::Lexeme::identifier_}    // first code point of 3 bytes
+                                                       , {0x20AC, Lexer::Lexeme::euro_}
+                                                       , {0x20AD, Lexer::Lexeme::unknown_}
+                                                       , {0xFFDC, Lexer::Lexeme::identifier_}   // last letter of 3 bytes
+                                                       , {0x10000, Lexer::Lexeme::identifier_}  // first code point of 4 bytes
+                                                       , {0x1F5FF, Lexer::Lexeme::unknown_}
+                                                       , {0x1F64F, Lexer::Lexeme::emoji_}
+                                                       , {0x1F650, Lexer::Lexeme::unknown_}
+                                                       , {0x3134A, Lexer::Lexeme::identifier_}  // last letter
+                                                       , {0x10FFFF, Lexer::Lexeme::unknown_} };
+    for (const auto& codePoint : codePoints)
+    {
+        std::string match;
+        auto str = toUtf8(codePoint.first);
+        EXPECT_EQ(codePoint.second, firstLexeme(str, match)) << "U+" << std::hex << codePoint.first;
+        if (codePoint.second != Lexer::Lexeme::unknown_)
+        {
+            EXPECT_EQ(str, match) << "U+" << std::hex << codePoint.first;
+        }
+    }
+}